@@ -0,0 +1,137 @@
+// libFuzzer harness for stb_image as the app builds it, decode arena included. Every
+// input goes through each load entry point the texture code uses, so the SIMD and
+// threaded fast paths are fuzzed along with the plain decoders.
+//
+//   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -Isrc \
+//       fuzz/stb_image_fuzz.cpp src/stb_image.cpp src/decode_arena.cpp -o stb_image_fuzz
+//   mkdir -p fuzz_corpus && ./stb_image_fuzz fuzz_corpus resources/benchmark
+//
+// resources/benchmark seeds it with one file per format and fast path. Without
+// libFuzzer, build with -DSTB_IMAGE_FUZZ_MAIN instead of -fsanitize=fuzzer and pass
+// files to replay them, which is how the seeds are kept as a regression check:
+//
+//   ./stb_image_fuzz resources/benchmark/*
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "decode_arena.h"
+#include "stb_image.h"
+
+// Inputs claiming more pixels than this are only probed, so the fuzzer spends its time
+// in the decoders instead of in allocating and filling huge images
+static const long long FUZZ_MAX_PIXELS = 4 * 1024 * 1024;
+
+// GIF frames read per input, each one is a full decode
+static const int FUZZ_MAX_GIF_FRAMES = 64;
+
+// Runs every task on the calling thread, which still splits the work like the pool does
+static void RunSerially(void* user, int count, void (*task)(void* taskData, int index), void* taskData) {
+	(void)user;
+	for (int i = 0; i < count; i++)
+		task(taskData, i);
+}
+
+// The _mt and _into file entry points read from disk, so the input is written to a file
+// of this process's own
+static const std::string& InputPath() {
+	static const std::string path = "stb_image_fuzz_" + std::to_string((long long)getpid()) + ".input";
+	return path;
+}
+
+static bool WriteInput(const uint8_t* data, size_t size) {
+	FILE* file = fopen(InputPath().c_str(), "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(data, 1, size, file) == size;
+	return fclose(file) == 0 && written;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	if (size > INT32_MAX)
+		return 0;
+	const stbi_uc* buffer = data;
+	int length = (int)size;
+
+	// The last byte picks the requested channels, the flip and whether the decode runs
+	// in an arena scope like the streamer's, so the corpus reaches them all. Outside a
+	// scope allocations come from the heap, where AddressSanitizer sees every one.
+	int desired = size ? data[size - 1] % 5 : 0;
+	int flip = size ? (data[size - 1] >> 3) & 1 : 0;
+	std::optional<DecodeArenaScope> arena;
+	if (size && (data[size - 1] >> 4) & 1)
+		arena.emplace();
+
+	int x = 0, y = 0, channels = 0;
+	if (!stbi_info_from_memory(buffer, length, &x, &y, &channels) || (long long)x * y > FUZZ_MAX_PIXELS) {
+		// Loaders reject what info rejects, except on the paths info doesn't parse fully
+		stbi_image_free(stbi_load_from_memory(buffer, length, &x, &y, &channels, 0));
+		return 0;
+	}
+
+	stbi_image_free(stbi_load_from_memory(buffer, length, &x, &y, &channels, desired));
+	stbi_image_free(stbi_load_16_from_memory(buffer, length, &x, &y, &channels, desired));
+	stbi_image_free(stbi_loadf_from_memory(buffer, length, &x, &y, &channels, desired));
+	stbi_image_free(stbi_load_from_memory_mt(buffer, length, &x, &y, &channels, desired, RunSerially, nullptr));
+	stbi_image_free(stbi_load_hdr_packed_from_memory(buffer, length, &x, &y, STBI_hdr_rgba16f, flip));
+	stbi_image_free(stbi_load_hdr_packed_from_memory(buffer, length, &x, &y, STBI_hdr_r11g11b10f, flip));
+
+	// Into caller memory with padded rows, which the loaders must not write past
+	int intoChannels = desired ? desired : 4;
+	int stride = x * intoChannels + 4;
+	std::vector<stbi_uc> dest((size_t)stride * y);
+	stbi_load_from_memory_into(buffer, length, dest.data(), dest.size(), stride, &x, &y, &channels, intoChannels, flip, RunSerially, nullptr);
+
+	if (WriteInput(data, size)) {
+		stbi_image_free(stbi_load_mt(InputPath().c_str(), &x, &y, &channels, desired, RunSerially, nullptr));
+		stbi_load_into(InputPath().c_str(), dest.data(), dest.size(), stride, &x, &y, &channels, intoChannels, !flip, nullptr, nullptr);
+	}
+
+	// Frames one at a time, then again after a rewind the way looping playback does
+	int width, height, delay;
+	if (stbi_gif_stream* gif = stbi_gif_stream_open_memory(buffer, length, &width, &height)) {
+		if ((long long)width * height <= FUZZ_MAX_PIXELS) {
+			int frames = 0;
+			while (frames < FUZZ_MAX_GIF_FRAMES && stbi_gif_stream_next(gif, &delay))
+				frames++;
+			stbi_gif_stream_rewind(gif);
+			stbi_gif_stream_next(gif, &delay);
+		}
+		stbi_gif_stream_close(gif);
+	}
+	return 0;
+}
+
+#ifdef STB_IMAGE_FUZZ_MAIN
+// Replays files through the harness without libFuzzer
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		FILE* file = fopen(argv[i], "rb");
+		if (!file) {
+			printf("stb_image_fuzz: can't open %s\n", argv[i]);
+			return 1;
+		}
+		std::vector<uint8_t> data;
+		uint8_t chunk[65536];
+		size_t read;
+		while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+			data.insert(data.end(), chunk, chunk + read);
+		fclose(file);
+		LLVMFuzzerTestOneInput(data.data(), data.size());
+		printf("stb_image_fuzz: %s (%zu bytes)\n", argv[i], data.size());
+	}
+	remove(InputPath().c_str());
+	return 0;
+}
+#endif
@@ -0,0 +1,95 @@
+#include "camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+Camera::Camera() {
+	update();
+}
+
+void Camera::setPerspective(float fovDegrees, float aspect, float nearPlane, float farPlane) {
+	setFov(fovDegrees);
+	setAspect(aspect);
+	if (nearPlane != this->nearPlane || farPlane != this->farPlane) {
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		projectionDirty = true;
+	}
+}
+
+void Camera::setFov(float fovDegrees) {
+	if (fovDegrees != fov) {
+		fov = fovDegrees;
+		projectionDirty = true;
+	}
+}
+
+void Camera::setAspect(float aspect) {
+	if (aspect != this->aspect) {
+		this->aspect = aspect;
+		projectionDirty = true;
+	}
+}
+
+void Camera::setPose(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up) {
+	if (position != this->position || front != this->front || up != this->up) {
+		this->position = position;
+		this->front = front;
+		this->up = up;
+		viewDirty = true;
+	}
+}
+
+bool Camera::update() {
+	if (!projectionDirty && !viewDirty)
+		return false;
+
+	if (projectionDirty) {
+		projectionMatrix = glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
+		projectionCount++;
+	}
+	if (viewDirty) {
+		viewMatrix = glm::lookAt(position, position + front, up);
+		viewCount++;
+	}
+	projectionDirty = viewDirty = false;
+	viewProjectionMatrix = projectionMatrix * viewMatrix;
+
+	// Each plane is the last row of the matrix plus or minus another row
+	glm::mat4 rows = glm::transpose(viewProjectionMatrix);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	revisionCount++;
+	return true;
+}
+
+bool Camera::visible(const glm::vec3& center, float radius) const {
+	for (const glm::vec4& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+CameraUniforms::CameraUniforms(const Shader& shader) {
+	viewLocation = glGetUniformLocation(shader.ID, "view");
+	projectionLocation = glGetUniformLocation(shader.ID, "projection");
+}
+
+void CameraUniforms::upload(const Camera& camera) {
+	if (camera.revision() == uploaded) {
+		skippedCount++;
+		return;
+	}
+	glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(camera.view()));
+	glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(camera.projection()));
+	uploaded = camera.revision();
+	uploadCount++;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// A perspective camera that keeps its view, projection, view-projection and frustum
+// planes between frames. Setters only mark what they change, update() rebuilds the
+// matrices that depend on it, and revision() moves on whenever any of them did, so
+// whoever uploads them can tell a stale copy from a current one. Copies are cheap
+// and independent, which is how a frame packet carries one to the render thread.
+class Camera {
+public:
+	Camera();
+
+	void setPerspective(float fovDegrees, float aspect, float nearPlane, float farPlane);
+	void setFov(float fovDegrees);
+	void setAspect(float aspect);
+	void setPose(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up);
+
+	// Rebuilds whatever changed since the last update, false if nothing did
+	bool update();
+
+	// Valid as of the last update()
+	const glm::mat4& view() const { return viewMatrix; }
+	const glm::mat4& projection() const { return projectionMatrix; }
+	const glm::mat4& viewProjection() const { return viewProjectionMatrix; }
+
+	// Planes as (normal, distance), normals pointing in: left, right, bottom, top, near, far
+	const glm::vec4& plane(int index) const { return planes[index]; }
+
+	// False only when the sphere is entirely outside one of the planes
+	bool visible(const glm::vec3& center, float radius) const;
+
+	unsigned long long revision() const { return revisionCount; }
+
+	// Times update() had to rebuild the projection and the view
+	unsigned int projectionRebuilds() const { return projectionCount; }
+	unsigned int viewRebuilds() const { return viewCount; }
+
+private:
+	float fov = 45.0f;
+	float aspect = 1.0f;
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+	bool projectionDirty = true;
+	bool viewDirty = true;
+
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 viewProjectionMatrix;
+	glm::vec4 planes[6];
+	unsigned long long revisionCount = 0;
+	unsigned int projectionCount = 0;
+	unsigned int viewCount = 0;
+};
+
+// A program's view and projection uniforms, set only when the camera handed in
+// is a different revision from the one last uploaded. Uniforms stay with the
+// program, so skipped frames draw with the same matrices.
+class CameraUniforms {
+public:
+	CameraUniforms(const Shader& shader);
+
+	// The program must be in use
+	void upload(const Camera& camera);
+
+	unsigned int uploads() const { return uploadCount; }
+	unsigned int skipped() const { return skippedCount; }
+
+private:
+	GLint viewLocation;
+	GLint projectionLocation;
+	unsigned long long uploaded = 0;   // revisions start at 1
+	unsigned int uploadCount = 0;
+	unsigned int skippedCount = 0;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "decode_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const size_t ARENA_ALIGNMENT = 16;
+static const size_t ARENA_MIN_CHUNK = 1024 * 1024;
+static const size_t ARENA_RETAINED_BYTES = 64 * 1024 * 1024; // kept per thread between decodes
+
+struct ArenaChunk {
+	unsigned char* data;
+	size_t size;
+	size_t used;
+};
+
+struct Arena {
+	std::vector<ArenaChunk> chunks;
+	size_t current = 0;   // chunk allocations are bumped out of
+	int depth = 0;        // open scopes
+	size_t inUse = 0;
+	size_t peak = 0;
+	unsigned int allocations = 0;
+	unsigned int reallocations = 0;
+
+	~Arena() {
+		for (ArenaChunk& chunk : chunks)
+			free(chunk.data);
+	}
+};
+
+static thread_local Arena arena;
+
+static size_t AlignSize(size_t size) {
+	return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static bool ArenaOwns(const void* pointer) {
+	const unsigned char* p = (const unsigned char*)pointer;
+	for (const ArenaChunk& chunk : arena.chunks) {
+		if (p >= chunk.data && p < chunk.data + chunk.size)
+			return true;
+	}
+	return false;
+}
+
+static void* ArenaAllocate(size_t size) {
+	size_t aligned = AlignSize(size);
+
+	// Chunks kept from earlier decodes are used up in order before a new one is added
+	while (arena.current < arena.chunks.size() && arena.chunks[arena.current].size - arena.chunks[arena.current].used < aligned)
+		arena.current++;
+	if (arena.current == arena.chunks.size()) {
+		size_t total = 0;
+		for (const ArenaChunk& chunk : arena.chunks)
+			total += chunk.size;
+		size_t chunkSize = std::max({ aligned, ARENA_MIN_CHUNK, total });
+		unsigned char* data = (unsigned char*)malloc(chunkSize);
+		if (!data)
+			return nullptr;
+		arena.chunks.push_back({ data, chunkSize, 0 });
+	}
+
+	ArenaChunk& chunk = arena.chunks[arena.current];
+	unsigned char* pointer = chunk.data + chunk.used;
+	chunk.used += aligned;
+	arena.inUse += aligned;
+	arena.peak = std::max(arena.peak, arena.inUse);
+	return pointer;
+}
+
+void* DecodeArenaMalloc(size_t size) {
+	if (arena.depth == 0)
+		return malloc(size);
+	arena.allocations++;
+	return ArenaAllocate(size);
+}
+
+void* DecodeArenaRealloc(void* pointer, size_t oldSize, size_t newSize) {
+	if (!pointer)
+		return DecodeArenaMalloc(newSize);
+	if (!ArenaOwns(pointer))
+		return realloc(pointer, newSize);
+	arena.reallocations++;
+
+	// The latest allocation grows in place while its chunk has room, which is how
+	// zlib output and PNG data buffers grow
+	ArenaChunk& chunk = arena.chunks[arena.current];
+	size_t oldAligned = AlignSize(oldSize);
+	size_t newAligned = AlignSize(newSize);
+	if ((unsigned char*)pointer + oldAligned == chunk.data + chunk.used && chunk.size - (chunk.used - oldAligned) >= newAligned) {
+		chunk.used = chunk.used - oldAligned + newAligned;
+		arena.inUse = arena.inUse - oldAligned + newAligned;
+		arena.peak = std::max(arena.peak, arena.inUse);
+		return pointer;
+	}
+
+	void* moved = ArenaAllocate(newSize);
+	if (moved)
+		memcpy(moved, pointer, std::min(oldSize, newSize));
+	return moved;
+}
+
+void DecodeArenaFree(void* pointer) {
+	// Arena memory is only released when its scope ends
+	if (pointer && !ArenaOwns(pointer))
+		free(pointer);
+}
+
+DecodeArenaScope::DecodeArenaScope() {
+	chunk = arena.current;
+	used = chunk < arena.chunks.size() ? arena.chunks[chunk].used : 0;
+	base = arena.inUse;
+	parentPeak = arena.peak;
+	arena.peak = arena.inUse;
+	allocations = arena.allocations;
+	reallocations = arena.reallocations;
+	arena.depth++;
+}
+
+DecodeArenaScope::~DecodeArenaScope() {
+	arena.depth--;
+	size_t peak = arena.peak;
+
+	// Rewind to where the scope started
+	arena.inUse = 0;
+	for (size_t i = chunk; i < arena.chunks.size(); i++)
+		arena.chunks[i].used = i == chunk ? used : 0;
+	for (const ArenaChunk& kept : arena.chunks)
+		arena.inUse += kept.used;
+	arena.current = chunk;
+	arena.peak = std::max(parentPeak, peak);
+
+	// After the outermost decode, leave a single chunk the size the decode needed,
+	// so the next similar one bumps out of one block
+	if (arena.depth == 0 && (arena.chunks.size() > 1 || (arena.chunks.size() == 1 && arena.chunks[0].size > ARENA_RETAINED_BYTES))) {
+		for (ArenaChunk& released : arena.chunks)
+			free(released.data);
+		arena.chunks.clear();
+
+		size_t keep = std::min(AlignSize(peak), ARENA_RETAINED_BYTES);
+		unsigned char* data = (unsigned char*)malloc(keep);
+		if (data)
+			arena.chunks.push_back({ data, keep, 0 });
+		arena.current = 0;
+		arena.inUse = 0;
+		arena.peak = 0;
+	}
+}
+
+DecodeArenaStats DecodeArenaScope::stats() const {
+	DecodeArenaStats stats;
+	stats.peakBytes = arena.peak - base;
+	stats.allocations = arena.allocations - allocations;
+	stats.reallocations = arena.reallocations - reallocations;
+	return stats;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef DECODE_ARENA_H
+#define DECODE_ARENA_H
+
+#include <cstddef>
+
+struct DecodeArenaStats {
+	size_t peakBytes = 0;           // most scratch memory in use at once
+	unsigned int allocations = 0;
+	unsigned int reallocations = 0;
+};
+
+// Marks the start of a decode on this thread. Until the scope ends, stb_image's
+// allocations on this thread are bumped out of a thread local arena and its frees
+// cost nothing; the end of the scope releases everything at once and keeps the
+// memory for the next decode. Scopes nest, each releasing only what it allocated.
+// Anything stb_image returns inside a scope is gone with it, so only decode into
+// caller memory (stbi_load_into) or free the result before the scope ends.
+class DecodeArenaScope {
+public:
+	DecodeArenaScope();
+	~DecodeArenaScope();
+
+	DecodeArenaScope(const DecodeArenaScope&) = delete;
+	DecodeArenaScope& operator=(const DecodeArenaScope&) = delete;
+
+	// Allocations made on this thread since the scope started
+	DecodeArenaStats stats() const;
+
+private:
+	size_t chunk;
+	size_t used;
+	size_t base;
+	size_t parentPeak;
+	unsigned int allocations;
+	unsigned int reallocations;
+};
+
+// Hooks for STBI_MALLOC, STBI_REALLOC_SIZED and STBI_FREE. Outside of a scope,
+// and for memory that did not come from the arena, they fall back to the heap.
+void* DecodeArenaMalloc(size_t size);
+void* DecodeArenaRealloc(void* pointer, size_t oldSize, size_t newSize);
+void DecodeArenaFree(void* pointer);
+
+#endif
@@ -0,0 +1,146 @@
+#include "decode_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "decode_arena.h"
+#include "mapped_file.h"
+#include "stb_image.h"
+
+// Each image is decoded until both are reached; the best run is reported
+static const int BENCHMARK_MIN_RUNS = 5;
+static const double BENCHMARK_SECONDS_PER_IMAGE = 0.25;
+
+struct BenchmarkImage {
+	std::string path;
+	MappedFile file;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	double bestSeconds = 0.0;
+	DecodeArenaStats scratch;
+};
+
+// Same as the streamer's, tasks on other threads allocate from their own arenas
+static void ParallelForOnPool(void* user, int count, void (*task)(void* taskData, int index), void* taskData) {
+	static_cast<ThreadPool*>(user)->parallelFor(count, [task, taskData](int index) {
+		DecodeArenaScope scope;
+		task(taskData, index);
+	});
+}
+
+// Decodes inside an arena scope like the streamer does, false if the image is not supported.
+// Only single threaded decodes record, concurrent ones share the image.
+static bool Decode(BenchmarkImage& image, ThreadPool* pool, bool record) {
+	DecodeArenaScope arena;
+	int width, height, channels;
+	int length = (int)image.file.size();
+	unsigned char* pixels = pool
+		? stbi_load_from_memory_mt(image.file.data(), length, &width, &height, &channels, 0, ParallelForOnPool, pool)
+		: stbi_load_from_memory(image.file.data(), length, &width, &height, &channels, 0);
+	if (!pixels)
+		return false;
+	stbi_image_free(pixels);
+	if (!record)
+		return true;
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	image.scratch = arena.stats();
+	return true;
+}
+
+// Radiance files decoded straight to the texture formats LoadHdrTexture uploads
+static double BestPackedSeconds(const BenchmarkImage& image, int format) {
+	double best = 0.0, total = 0.0;
+	for (int run = 0; run < BENCHMARK_MIN_RUNS || total < BENCHMARK_SECONDS_PER_IMAGE; run++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		DecodeArenaScope arena;
+		int width, height;
+		stbi_image_free(stbi_load_hdr_packed_from_memory(image.file.data(), (int)image.file.size(), &width, &height, format, true));
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = run == 0 ? seconds : std::min(best, seconds);
+		total += seconds;
+	}
+	return best;
+}
+
+static double BestDecodeSeconds(BenchmarkImage& image, ThreadPool* pool) {
+	double best = 0.0, total = 0.0;
+	for (int run = 0; run < BENCHMARK_MIN_RUNS || total < BENCHMARK_SECONDS_PER_IMAGE; run++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Decode(image, pool, pool == nullptr);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = run == 0 ? seconds : std::min(best, seconds);
+		total += seconds;
+	}
+	return best;
+}
+
+void RunDecodeBenchmark(const char* directory, ThreadPool& pool) {
+	std::vector<std::unique_ptr<BenchmarkImage>> images;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+		if (!it->is_regular_file(error))
+			continue;
+		std::unique_ptr<BenchmarkImage> image(new BenchmarkImage());
+		image->path = it->path().lexically_normal().generic_string();
+		// The first decode also faults the mapping in, so no run reads the disk
+		if (image->file.open(image->path.c_str()) && image->file.size() <= INT_MAX && Decode(*image, nullptr, true))
+			images.push_back(std::move(image));
+		else
+			std::cout << "Decode benchmark: skipping " << it->path().generic_string() << std::endl;
+	}
+	std::sort(images.begin(), images.end(), [](const std::unique_ptr<BenchmarkImage>& a, const std::unique_ptr<BenchmarkImage>& b) {
+		return a->path < b->path;
+	});
+	if (images.empty()) {
+		std::cout << "Decode benchmark: no images in " << directory << std::endl;
+		return;
+	}
+
+	unsigned int threads = pool.threadCount() + 1; // parallelFor also runs on the calling thread
+	double setSeconds = 0.0;
+	for (std::unique_ptr<BenchmarkImage>& image : images) {
+		image->bestSeconds = BestDecodeSeconds(*image, nullptr);
+		setSeconds += image->bestSeconds;
+		double splitSeconds = BestDecodeSeconds(*image, &pool);
+
+		double fileMB = image->file.size() / (1024.0 * 1024.0);
+		double pixels = (double)image->width * image->height;
+		std::cout << "Decode benchmark: " << image->path << " (" << image->width << "x" << image->height << ", "
+			<< image->channels << " channels, " << image->file.size() / 1024 << " KB) "
+			<< image->bestSeconds * 1000.0 << " ms, " << fileMB / image->bestSeconds << " MB/s, "
+			<< pixels / image->bestSeconds / 1e6 << " Mpixels/s, " << image->scratch.allocations << " allocations, "
+			<< image->scratch.peakBytes / 1024 << " KB arena peak, " << splitSeconds * 1000.0 << " ms split over "
+			<< threads << " threads" << std::endl;
+
+		if (stbi_is_hdr_from_memory(image->file.data(), (int)image->file.size())) {
+			double halfSeconds = BestPackedSeconds(*image, STBI_hdr_rgba16f);
+			double packedSeconds = BestPackedSeconds(*image, STBI_hdr_r11g11b10f);
+			std::cout << "Decode benchmark: " << image->path << " RGBA16F " << halfSeconds * 1000.0 << " ms, "
+				<< fileMB / halfSeconds << " MB/s, R11G11B10F " << packedSeconds * 1000.0 << " ms, "
+				<< fileMB / packedSeconds << " MB/s" << std::endl;
+		}
+	}
+
+	// Independent decodes on every thread, the way the streamer's workers load a scene
+	int passes = std::max(1, (int)(BENCHMARK_SECONDS_PER_IMAGE * images.size() / setSeconds));
+	int count = (int)images.size() * passes;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	pool.parallelFor(count, [&images](int index) {
+		Decode(*images[index % images.size()], nullptr, false);
+	});
+	double concurrentSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / passes;
+
+	std::cout << "Decode benchmark: " << images.size() << " images in " << setSeconds * 1000.0 << " ms on one thread, "
+		<< concurrentSeconds * 1000.0 << " ms on " << threads << " threads at once ("
+		<< setSeconds / concurrentSeconds << "x)" << std::endl;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef DECODE_BENCHMARK_H
+#define DECODE_BENCHMARK_H
+
+#include "thread_pool.h"
+
+// Decodes every image under directory with stbi_load_from_memory and logs, per image,
+// the best time, throughput and stb_image's allocations, alone and split over the pool
+// with stbi_load_from_memory_mt. Radiance files are also timed decoding to the packed
+// RGBA16F and R11G11B10F texture formats. Then the whole set is decoded on every thread
+// at once.
+void RunDecodeBenchmark(const char* directory, ThreadPool& pool);
+
+#endif
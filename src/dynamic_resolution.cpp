@@ -0,0 +1,175 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// Scales are kept on steps of this size, so only a few target sizes ever exist
+static const float RESOLUTION_SCALE_STEP = 0.05f;
+
+// Frames over budget before dropping, and comfortably under before climbing
+static const unsigned int RESOLUTION_DROP_FRAMES = 3;
+static const unsigned int RESOLUTION_RAISE_FRAMES = 60;
+
+// Under budget means under this fraction of it, so one step up still fits
+static const double RESOLUTION_RAISE_HEADROOM = 0.75;
+
+// The first frames pay for shader compiles and uploads, so they don't steer
+static const unsigned long long RESOLUTION_WARMUP_FRAMES = 8;
+
+// Weight of the newest timing in the smoothed GPU time
+static const double RESOLUTION_SMOOTHING = 0.2;
+
+// Frames waiting on a timing before the oldest is written without one
+static const size_t RESOLUTION_PENDING_FRAMES = 64;
+
+static float QuantizeScale(float scale) {
+	return std::round(scale / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP;
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionConfig& config, Shader& upscaleShader, RenderTargetPool& pool, int width, int height)
+	: config(config), upscale(upscaleShader), targets(pool), target(), baseWidth(std::max(width, 1)), baseHeight(std::max(height, 1)),
+	currentScale(config.maxScale) {
+	glGenVertexArrays(1, &emptyVertexArray);
+	setScale(currentScale);
+}
+
+DynamicResolution::~DynamicResolution() {
+	if (logFile)
+		fclose(logFile);
+}
+
+void DynamicResolution::resize(int width, int height) {
+	baseWidth = std::max(width, 1);
+	baseHeight = std::max(height, 1);
+	setScale(currentScale);
+}
+
+void DynamicResolution::setScale(float scale) {
+	currentScale = std::min(std::max(QuantizeScale(scale), config.minScale), config.maxScale);
+	sceneWidth = std::max(1, (int)std::lround(baseWidth * currentScale));
+	sceneHeight = std::max(1, (int)std::lround(baseHeight * currentScale));
+
+	// Timings from the old size say nothing about the new one
+	smoothed = -1.0;
+	overBudget = underBudget = 0;
+}
+
+void DynamicResolution::beginScene(unsigned long long frame) {
+	pending.push_back({ frame, sceneWidth, sceneHeight, currentScale, -1.0 });
+	if (pending.size() > RESOLUTION_PENDING_FRAMES) {
+		writeRecord(pending.front());
+		pending.pop_front();
+	}
+
+	int targetWidth = std::max(1, (int)std::lround(baseWidth * config.maxScale));
+	int targetHeight = std::max(1, (int)std::lround(baseHeight * config.maxScale));
+	target = targets.acquire({ targetWidth, targetHeight, GL_RGBA8, GL_DEPTH_COMPONENT24, 0 });
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glViewport(0, 0, sceneWidth, sceneHeight);
+	timer.begin(frame);
+}
+
+void DynamicResolution::endScene() {
+	timer.end();
+}
+
+void DynamicResolution::present(int width, int height) {
+	int targetWidth = target.key.width, targetHeight = target.key.height;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+
+	// The scene covers the corner of the target it was drawn into
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	upscale.use();
+	upscale.setInt("scene", 0);
+	upscale.setVec2("texelSize", 1.0f / targetWidth, 1.0f / targetHeight);
+	upscale.setVec2("sceneExtent", (float)sceneWidth / targetWidth, (float)sceneHeight / targetHeight);
+	upscale.setFloat("sharpness", config.filter == UpscaleFilter::Sharpened && currentScale < 1.0f ? 0.25f : 0.0f);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, target.color);
+	glBindVertexArray(emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+
+	GpuTimerResult result;
+	while (timer.poll(result))
+		control(result.tag, result.seconds);
+}
+
+void DynamicResolution::control(unsigned long long frame, double seconds) {
+	// Timings come back in order, so frames older than this one never got one
+	while (!pending.empty() && pending.front().frame < frame) {
+		writeRecord(pending.front());
+		pending.pop_front();
+	}
+	if (pending.empty() || pending.front().frame != frame)
+		return;
+	FrameRecord record = pending.front();
+	pending.pop_front();
+	record.gpuSeconds = seconds;
+	writeRecord(record);
+
+	// Frames drawn before the last change don't count
+	if (frame < RESOLUTION_WARMUP_FRAMES || record.width != sceneWidth || record.height != sceneHeight)
+		return;
+
+	smoothed = smoothed < 0.0 ? seconds : smoothed + (seconds - smoothed) * RESOLUTION_SMOOTHING;
+	overBudget = smoothed > config.gpuBudget ? overBudget + 1 : 0;
+	underBudget = smoothed < config.gpuBudget * RESOLUTION_RAISE_HEADROOM ? underBudget + 1 : 0;
+
+	float scale = currentScale;
+	if (overBudget >= RESOLUTION_DROP_FRAMES && currentScale > config.minScale) {
+		// Time goes with pixel count, so the square root of the overshoot is how far to drop
+		float wanted = currentScale * (float)std::sqrt(config.gpuBudget / smoothed);
+		scale = std::min(wanted, currentScale - RESOLUTION_SCALE_STEP);
+	}
+	else if (underBudget >= RESOLUTION_RAISE_FRAMES && currentScale < config.maxScale)
+		scale = currentScale + RESOLUTION_SCALE_STEP;
+	else
+		return;
+
+	int oldWidth = sceneWidth, oldHeight = sceneHeight;
+	setScale(scale);
+	changes++;
+	std::cout << "Dynamic resolution: " << oldWidth << "x" << oldHeight << " to " << sceneWidth << "x" << sceneHeight
+		<< " (scene took " << seconds * 1000.0 << " ms, budget " << config.gpuBudget * 1000.0 << " ms)" << std::endl;
+}
+
+bool DynamicResolution::openLog(const char* path) {
+	logPath = path;
+	logFile = fopen(path, "w");
+	if (!logFile) {
+		std::cout << "Failed to write dynamic resolution log: " << path << std::endl;
+		return false;
+	}
+	fprintf(logFile, "frame,width,height,scale,gpu_ms\n");
+	return true;
+}
+
+void DynamicResolution::writeRecord(const FrameRecord& record) {
+	if (logFile) {
+		fprintf(logFile, "%llu,%d,%d,%.2f,%.4f\n", record.frame, record.width, record.height, record.scale,
+			record.gpuSeconds * 1000.0);
+	}
+	loggedFrames++;
+	scaleSum += record.scale;
+}
+
+bool DynamicResolution::closeLog() {
+	for (const FrameRecord& record : pending)
+		writeRecord(record);
+	pending.clear();
+	bool written = logFile && fclose(logFile) == 0;
+	logFile = nullptr;
+
+	std::cout << "Dynamic resolution: " << loggedFrames << " frames, " << changes << " changes, average scale "
+		<< (loggedFrames ? scaleSum / loggedFrames : 0.0) << " (" << (logPath ? logPath : "no log") << ")" << std::endl;
+	return written;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <deque>
+
+#include "gpu_timer.h"
+#include "render_target_pool.h"
+#include "shader.h"
+
+enum class UpscaleFilter {
+	Bilinear,
+	Sharpened
+};
+
+struct DynamicResolutionConfig {
+	double gpuBudget = 1.0 / 120.0;   // seconds of GPU time the scene pass may take
+	float minScale = 0.5f;            // of the backbuffer's width and height
+	float maxScale = 1.0f;
+	UpscaleFilter filter = UpscaleFilter::Sharpened;
+};
+
+// Draws the scene into an offscreen target whose size follows a GPU time budget,
+// then upscales it to the backbuffer. GL_TIME_ELAPSED queries time the scene pass.
+// The resolution drops quickly when the budget is exceeded and only climbs back
+// after a long run of frames comfortably under it, so it doesn't flicker between
+// two sizes. The target comes from the pool at full scale and smaller scenes draw
+// into its corner, so only a resize asks for a new one.
+class DynamicResolution {
+public:
+	// The upscale shader samples "scene" and takes "texelSize", "sceneExtent" and "sharpness"
+	DynamicResolution(const DynamicResolutionConfig& config, Shader& upscaleShader, RenderTargetPool& pool, int width, int height);
+
+	~DynamicResolution();
+
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	// Size the scale applies to. The backbuffer can differ for a while, the scene
+	// is stretched over it until this catches up.
+	void resize(int width, int height);
+
+	// Binds the offscreen target at this frame's resolution and starts timing
+	void beginScene(unsigned long long frame);
+	void endScene();
+
+	// Upscales the scene to a backbuffer of this size, then adjusts the resolution
+	// from whichever timings have come back
+	void present(int width, int height);
+
+	int width() const { return sceneWidth; }
+	int height() const { return sceneHeight; }
+	int fullWidth() const { return baseWidth; }
+	int fullHeight() const { return baseHeight; }
+	float scale() const { return currentScale; }
+
+	// Writes the resolution chosen for every frame as CSV, a row as soon as the frame's
+	// GPU time comes back, so the log costs no memory however long the run
+	bool openLog(const char* path);
+
+	// Writes the frames still waiting on a timing and prints a summary
+	bool closeLog();
+
+private:
+	struct FrameRecord {
+		unsigned long long frame;
+		int width;
+		int height;
+		float scale;
+		double gpuSeconds;
+	};
+
+	void control(unsigned long long frame, double seconds);
+	void setScale(float scale);
+	void writeRecord(const FrameRecord& record);
+
+	DynamicResolutionConfig config;
+	Shader& upscale;
+	RenderTargetPool& targets;
+	RenderTarget target;     // this frame's, at full scale
+	GpuTimer timer;
+	GLuint emptyVertexArray = 0;
+	int baseWidth;
+	int baseHeight;
+	int sceneWidth = 0;
+	int sceneHeight = 0;
+	float currentScale;
+
+	double smoothed = -1.0;  // GPU seconds at the current scale, smoothed
+	unsigned int overBudget = 0;
+	unsigned int underBudget = 0;
+	unsigned int changes = 0;
+
+	// Frames drawn but not timed yet, and sums over the ones written
+	std::deque<FrameRecord> pending;
+	FILE* logFile = nullptr;
+	const char* logPath = nullptr;
+	unsigned long long loggedFrames = 0;
+	double scaleSum = 0.0;
+};
+
+#endif
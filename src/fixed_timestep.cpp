@@ -0,0 +1,33 @@
+#include "fixed_timestep.h"
+
+FixedTimestep::FixedTimestep(double stepsPerSecond, int maxSteps)
+	: stepSeconds(1.0 / stepsPerSecond), maxSteps(maxSteps) {
+}
+
+void FixedTimestep::accumulate(double now) {
+	if (!started) {
+		lastTime = stepEnd = now;
+		started = true;
+		return;
+	}
+	if (now > lastTime)
+		accumulator += now - lastTime;
+	lastTime = now;
+
+	// Skip ahead rather than run more steps than a frame allows
+	double limit = stepSeconds * maxSteps;
+	if (accumulator > limit) {
+		dropped += accumulator - limit;
+		stepEnd += accumulator - limit;
+		accumulator = limit;
+	}
+}
+
+bool FixedTimestep::consume() {
+	if (accumulator < stepSeconds)
+		return false;
+	accumulator -= stepSeconds;
+	stepEnd += stepSeconds;
+	stepCount++;
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Turns frame to frame real time into whole simulation steps of a fixed length.
+// Time left over in the accumulator is less than a step; alpha() says how far into
+// the next step the frame is, for drawing between the last two states.
+class FixedTimestep {
+public:
+	// Past maxSteps in one frame the rest of the time is dropped, so a long stall
+	// doesn't leave the simulation trying to catch up forever
+	FixedTimestep(double stepsPerSecond, int maxSteps = 8);
+
+	// Adds the real time elapsed up to now, the first call only sets the start
+	void accumulate(double now);
+
+	// True while a whole step is left in the accumulator, and takes it
+	bool consume();
+
+	// True if another step is waiting behind the one just consumed
+	bool pending() const { return accumulator >= stepSeconds; }
+
+	double step() const { return stepSeconds; }
+
+	// Real time the step just consumed ends at
+	double time() const { return stepEnd; }
+
+	// Steps run since the start
+	unsigned long long steps() const { return stepCount; }
+
+	// How far past the last step the accumulated time is, in [0, 1)
+	float alpha() const { return (float)(accumulator / stepSeconds); }
+
+	// Seconds thrown away because a frame needed more than maxSteps
+	double droppedSeconds() const { return dropped; }
+
+private:
+	double stepSeconds;
+	int maxSteps;
+	double accumulator = 0.0;
+	double stepEnd = 0.0;
+	double lastTime = 0.0;
+	double dropped = 0.0;
+	bool started = false;
+	unsigned long long stepCount = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+// A sleep wakes up this close to the deadline at the latest, the rest is spun
+static const double PACER_SPIN_SECONDS = 0.002;
+
+// Histogram bins, frames longer than the last bin land in it
+static const double PACER_BIN_SECONDS = 0.00025;
+static const unsigned int PACER_BIN_COUNT = 400;
+
+FramePacer::FramePacer(PacingMode mode, double framesPerSecond)
+	: pacingMode(mode), period(1.0 / framesPerSecond), bins(PACER_BIN_COUNT, 0) {
+}
+
+const char* FramePacer::Name(PacingMode mode) {
+	switch (mode) {
+	case PacingMode::VSync: return "vsync";
+	case PacingMode::AdaptiveVSync: return "adaptive vsync";
+	case PacingMode::Capped: return "capped";
+	case PacingMode::Uncapped: return "uncapped";
+	}
+	return "";
+}
+
+void FramePacer::apply() {
+	if (pacingMode == PacingMode::AdaptiveVSync && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+		&& !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+		std::cout << "Frame pacing: no swap control tear, using vsync" << std::endl;
+		pacingMode = PacingMode::VSync;
+	}
+
+	switch (pacingMode) {
+	case PacingMode::VSync: glfwSwapInterval(1); break;
+	case PacingMode::AdaptiveVSync: glfwSwapInterval(-1); break;
+	case PacingMode::Capped:
+	case PacingMode::Uncapped: glfwSwapInterval(0); break;
+	}
+}
+
+double FramePacer::pace() {
+	double now = glfwGetTime();
+	double start = now;
+
+	if (pacingMode == PacingMode::Capped) {
+		// A frame that ran late starts the schedule over rather than rushing to catch up
+		deadline = std::max(deadline + period, now);
+		double sleep = deadline - now - PACER_SPIN_SECONDS;
+		if (sleep > 0.0)
+			std::this_thread::sleep_for(std::chrono::duration<double>(sleep));
+		while ((now = glfwGetTime()) < deadline)
+			;
+		waited += now - start;
+	}
+
+	if (lastStart >= 0.0) {
+		double frame = now - lastStart;
+		frameCount++;
+		double delta = frame - meanSeconds;
+		meanSeconds += delta / frameCount;
+		sumSquares += delta * (frame - meanSeconds);
+		longest = std::max(longest, frame);
+		bins[std::min((size_t)(frame / PACER_BIN_SECONDS), bins.size() - 1)]++;
+	}
+	lastStart = now;
+	return now - start;
+}
+
+double FramePacer::percentile(double fraction) const {
+	unsigned long long wanted = (unsigned long long)std::ceil(fraction * frameCount), seen = 0;
+	for (size_t i = 0; i < bins.size(); i++) {
+		seen += bins[i];
+		if (seen >= wanted && seen > 0)
+			return i + 1 == bins.size() ? longest : (i + 1) * PACER_BIN_SECONDS;
+	}
+	return longest;
+}
+
+bool FramePacer::writeHistogram(const char* path) const {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		std::cout << "Failed to write frame pacing histogram: " << path << std::endl;
+		return false;
+	}
+	fprintf(file, "frame_ms,frames\n");
+	for (size_t i = 0; i < bins.size(); i++) {
+		if (bins[i])
+			fprintf(file, "%.2f,%u\n", i * PACER_BIN_SECONDS * 1000.0, bins[i]);
+	}
+	bool written = fclose(file) == 0;
+
+	std::cout << "Frame pacing: " << Name(pacingMode) << ", " << frameCount << " frames, " << mean() * 1000.0
+		<< " ms mean, " << std::sqrt(variance()) * 1000.0 << " ms deviation, " << percentile(0.99) * 1000.0
+		<< " ms 99th, " << longest * 1000.0 << " ms longest, " << waited * 1000.0 << " ms waited ("
+		<< path << ")" << std::endl;
+	return written;
+}
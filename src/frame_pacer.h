@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <vector>
+
+enum class PacingMode {
+	VSync,          // swap interval 1
+	AdaptiveVSync,  // swap interval -1, tears instead of waiting a whole refresh when late
+	Capped,         // no vsync, the CPU waits until the next frame is due
+	Uncapped        // no vsync and no waiting
+};
+
+// Decides when frames start and keeps a record of how evenly they came. Capped
+// frames sleep until shortly before they are due and spin the rest of the way,
+// since a sleep alone can overshoot by a scheduler tick.
+class FramePacer {
+public:
+	FramePacer(PacingMode mode, double framesPerSecond = 60.0);
+
+	// Sets the swap interval on the current context. Adaptive falls back to plain
+	// vsync without WGL/GLX_EXT_swap_control_tear.
+	void apply();
+
+	// Call at the top of every frame, before input is gathered. Returns the seconds
+	// spent waiting for the frame to be due.
+	double pace();
+
+	PacingMode mode() const { return pacingMode; }
+	static const char* Name(PacingMode mode);
+
+	// Start to start frame time in seconds
+	double mean() const { return frameCount ? meanSeconds : 0.0; }
+	double variance() const { return frameCount > 1 ? sumSquares / (frameCount - 1) : 0.0; }
+
+	// Writes the frame time histogram as CSV and prints a summary
+	bool writeHistogram(const char* path) const;
+
+private:
+	double percentile(double fraction) const;
+
+	PacingMode pacingMode;
+	double period;
+	double deadline = 0.0;
+	double lastStart = -1.0;
+	double waited = 0.0;
+
+	// Running mean and variance (Welford), and the histogram
+	unsigned long long frameCount = 0;
+	double meanSeconds = 0.0;
+	double sumSquares = 0.0;
+	double longest = 0.0;
+	std::vector<unsigned int> bins;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "camera.h"
+#include "simulation.h"
+
+struct PacketInstance {
+	glm::mat4 model;
+	glm::vec3 center;   // bounding sphere, for the texture footprint
+	float radius;
+};
+
+// An input event the frame's steps consumed, for latency tracking
+struct PacketInput {
+	unsigned int id;
+	double time;        // delivered
+	double consumed;    // taken by a simulation step
+};
+
+// Everything the render thread needs to draw one frame, built by the simulation
+// thread and never changed after it is queued
+struct FramePacket {
+	unsigned long long frame = 0;
+	unsigned int steps = 0;         // simulation steps run for this frame
+	SimulationState state;          // interpolated between the last two steps
+	Camera camera;                  // updated, only instances inside its frustum are queued
+	float mixAmount = 0.0f;
+	std::vector<PacketInstance> instances;
+	std::vector<PacketInput> inputs;
+};
+
+#endif
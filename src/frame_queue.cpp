@@ -0,0 +1,58 @@
+#include "frame_queue.h"
+
+#include <algorithm>
+#include <chrono>
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+FrameQueue::FrameQueue(size_t depth) : maxDepth(std::max<size_t>(depth, 1)) {
+}
+
+bool FrameQueue::push(std::shared_ptr<const FramePacket> packet) {
+	std::unique_lock<std::mutex> lock(packetsMutex);
+	if (packets.size() >= maxDepth && !closed) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		packetsChanged.wait(lock, [this] { return packets.size() < maxDepth || closed; });
+		currentStats.producerStalls++;
+		currentStats.producerWait += SecondsSince(start);
+	}
+	if (closed)
+		return false;
+	packets.push_back(std::move(packet));
+	currentStats.packets++;
+	lock.unlock();
+	packetsChanged.notify_all();
+	return true;
+}
+
+std::shared_ptr<const FramePacket> FrameQueue::pop() {
+	std::unique_lock<std::mutex> lock(packetsMutex);
+	if (packets.empty() && !closed) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		packetsChanged.wait(lock, [this] { return !packets.empty() || closed; });
+		currentStats.consumerStalls++;
+		currentStats.consumerWait += SecondsSince(start);
+	}
+	if (packets.empty())
+		return nullptr;
+	std::shared_ptr<const FramePacket> packet = std::move(packets.front());
+	packets.pop_front();
+	lock.unlock();
+	packetsChanged.notify_all();
+	return packet;
+}
+
+void FrameQueue::close() {
+	{
+		std::lock_guard<std::mutex> lock(packetsMutex);
+		closed = true;
+	}
+	packetsChanged.notify_all();
+}
+
+FrameQueueStats FrameQueue::stats() const {
+	std::lock_guard<std::mutex> lock(packetsMutex);
+	return currentStats;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "frame_packet.h"
+
+struct FrameQueueStats {
+	unsigned long long packets = 0;
+	unsigned int producerStalls = 0;   // pushes that found the queue full
+	unsigned int consumerStalls = 0;   // pops that found it empty
+	double producerWait = 0.0;         // seconds
+	double consumerWait = 0.0;
+};
+
+// Hands frame packets from the simulation thread to the render thread. The depth
+// bounds how many frames the simulation can run ahead, and so how old the input
+// in a drawn frame can be; a full queue holds the simulation back.
+class FrameQueue {
+public:
+	FrameQueue(size_t depth);
+
+	FrameQueue(const FrameQueue&) = delete;
+	FrameQueue& operator=(const FrameQueue&) = delete;
+
+	// Waits while the queue is full, false once it has been closed
+	bool push(std::shared_ptr<const FramePacket> packet);
+
+	// Waits while the queue is empty, nullptr once it is closed and drained
+	std::shared_ptr<const FramePacket> pop();
+
+	// Wakes both sides, packets already queued can still be popped
+	void close();
+
+	size_t depth() const { return maxDepth; }
+	FrameQueueStats stats() const;
+
+private:
+	size_t maxDepth;
+	std::deque<std::shared_ptr<const FramePacket>> packets;
+	mutable std::mutex packetsMutex;
+	std::condition_variable packetsChanged;
+	bool closed = false;
+	FrameQueueStats currentStats;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "frame_timings.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+void FrameTimings::frame(unsigned long long frame, unsigned int steps, const SimulationState& state, double cpuSeconds) {
+	if (rows.size() <= frame)
+		rows.resize((size_t)frame + 1, { 0, SimulationState(), 0.0, -1.0 });
+	rows[(size_t)frame].steps = steps;
+	rows[(size_t)frame].state = state;
+	rows[(size_t)frame].cpuSeconds = cpuSeconds;
+}
+
+void FrameTimings::gpu(unsigned long long frame, double seconds) {
+	if (frame < rows.size())
+		rows[(size_t)frame].gpuSeconds = seconds;
+}
+
+static double Percentile(std::vector<double>& values, double fraction) {
+	if (values.empty())
+		return 0.0;
+	size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+bool FrameTimings::write(const char* path) const {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		std::cout << "Failed to write frame timings: " << path << std::endl;
+		return false;
+	}
+
+	// Simulated values are printed exactly so files from two builds compare with diff
+	std::vector<double> cpu, gpu;
+	fprintf(file, "frame,steps,time,spin,fov,cpu_ms,gpu_ms\n");
+	for (size_t i = 0; i < rows.size(); i++) {
+		const Row& row = rows[i];
+		fprintf(file, "%zu,%u,%.17g,%.9g,%.9g,%.4f,%.4f\n", i, row.steps, row.state.time,
+			row.state.spinAngle, row.state.fov, row.cpuSeconds * 1000.0, row.gpuSeconds * 1000.0);
+		cpu.push_back(row.cpuSeconds * 1000.0);
+		if (row.gpuSeconds >= 0.0)
+			gpu.push_back(row.gpuSeconds * 1000.0);
+	}
+	bool written = fclose(file) == 0;
+
+	std::cout << "Frame timings: " << path << " (" << rows.size() << " frames, CPU "
+		<< Percentile(cpu, 0.5) << " ms median " << Percentile(cpu, 0.99) << " ms 99th, GPU "
+		<< Percentile(gpu, 0.5) << " ms median " << Percentile(gpu, 0.99) << " ms 99th)" << std::endl;
+	return written;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef FRAME_TIMINGS_H
+#define FRAME_TIMINGS_H
+
+#include <vector>
+
+#include "simulation.h"
+
+// Per frame record of a replayed run. The simulated columns are the same for every
+// build replaying the same log, so two runs' files line up frame by frame and only
+// the CPU and GPU columns differ.
+class FrameTimings {
+public:
+	void frame(unsigned long long frame, unsigned int steps, const SimulationState& state, double cpuSeconds);
+
+	// GPU time arrives a few frames later
+	void gpu(unsigned long long frame, double seconds);
+
+	// Writes one line per frame as CSV and prints a summary, false if the file failed
+	bool write(const char* path) const;
+
+private:
+	struct Row {
+		unsigned int steps;
+		SimulationState state;
+		double cpuSeconds;
+		double gpuSeconds;
+	};
+
+	std::vector<Row> rows;
+};
+
+#endif
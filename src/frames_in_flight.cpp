@@ -0,0 +1,113 @@
+#include "frames_in_flight.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <GLFW/glfw3.h>
+
+static const double FRAMES_CALIBRATION_SECONDS = 1.0;
+
+FramesInFlight::FramesInFlight(unsigned int maxFrames) : maxInFlight(maxFrames) {
+}
+
+double FramesInFlight::wait() {
+	// Finished frames are collected either way, so retire() keeps up
+	while (!inFlight.empty() && finish(false))
+		;
+	if (maxInFlight == 0 || inFlight.size() < maxInFlight)
+		return 0.0;
+
+	double start = glfwGetTime();
+	while (inFlight.size() >= maxInFlight)
+		finish(true);
+	double seconds = glfwGetTime() - start;
+	cpuWait += seconds;
+	waitCount++;
+	return seconds;
+}
+
+GLuint FramesInFlight::allocateQuery() {
+	if (freeQueries.empty()) {
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		return query;
+	}
+	GLuint query = freeQueries.back();
+	freeQueries.pop_back();
+	return query;
+}
+
+void FramesInFlight::calibrate() {
+	// Both clocks read back to back, the call itself is well under a millisecond
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	double cpuNow = glfwGetTime();
+	gpuClockOffset = gpuNow * 1e-9 - cpuNow;
+	calibrated = cpuNow;
+}
+
+void FramesInFlight::begin(unsigned long long frame) {
+	if (calibrated < 0.0 || glfwGetTime() - calibrated >= FRAMES_CALIBRATION_SECONDS)
+		calibrate();
+
+	building.number = frame;
+	building.startQuery = allocateQuery();
+	glQueryCounter(building.startQuery, GL_TIMESTAMP);
+}
+
+void FramesInFlight::end() {
+	building.endQuery = allocateQuery();
+	glQueryCounter(building.endQuery, GL_TIMESTAMP);
+	building.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	inFlight.push_back(building);
+	frameCount++;
+}
+
+bool FramesInFlight::finish(bool wait) {
+	Frame& oldest = inFlight.front();
+	GLenum status = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		if (!wait)
+			return false;
+		while (glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+	}
+	glDeleteSync(oldest.fence);
+
+	// Past the fence, so both timestamps are ready
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(oldest.startQuery, GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(oldest.endQuery, GL_QUERY_RESULT, &end);
+	freeQueries.push_back(oldest.startQuery);
+	freeQueries.push_back(oldest.endQuery);
+
+	RetiredFrame frame = { oldest.number, start * 1e-9 - gpuClockOffset, end * 1e-9 - gpuClockOffset };
+	gpuBusy += std::max(0.0, frame.gpuEnd - frame.gpuStart);
+	if (lastGpuEnd >= 0.0)
+		gpuIdle += std::max(0.0, frame.gpuStart - lastGpuEnd);
+	lastGpuEnd = frame.gpuEnd;
+
+	retired.push_back(frame);
+	inFlight.pop_front();
+	return true;
+}
+
+bool FramesInFlight::retire(RetiredFrame& frame) {
+	while (!inFlight.empty() && finish(false))
+		;
+	if (retired.empty())
+		return false;
+	frame = retired.front();
+	retired.pop_front();
+	return true;
+}
+
+void FramesInFlight::report() const {
+	std::cout << "Frames in flight: " << frameCount << " frames, ";
+	if (maxInFlight)
+		std::cout << "at most " << maxInFlight;
+	else
+		std::cout << "no limit";
+	std::cout << ", CPU waited " << cpuWait * 1000.0 << " ms over " << waitCount << " frames, GPU idle "
+		<< gpuIdle * 1000.0 << " ms and busy " << gpuBusy * 1000.0 << " ms" << std::endl;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef FRAMES_IN_FLIGHT_H
+#define FRAMES_IN_FLIGHT_H
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <vector>
+
+// When the GPU ran a frame, on the glfwGetTime() clock
+struct RetiredFrame {
+	unsigned long long frame;
+	double gpuStart;
+	double gpuEnd;
+};
+
+// Limits how many submitted frames the GPU may still be working on. Each frame is
+// bracketed by GL_TIMESTAMP queries and fenced after its swap; before the next frame
+// the CPU waits on the oldest fence while the limit is reached. The timestamps tell
+// how long the GPU sat idle between frames, waiting on the CPU, against how long the
+// CPU sat waiting on the GPU. Fences and queries go away with the context.
+class FramesInFlight {
+public:
+	// maxFrames of 0 leaves queueing up to the driver
+	FramesInFlight(unsigned int maxFrames);
+
+	FramesInFlight(const FramesInFlight&) = delete;
+	FramesInFlight& operator=(const FramesInFlight&) = delete;
+
+	void setMaxFrames(unsigned int frames) { maxInFlight = frames; }
+	unsigned int maxFrames() const { return maxInFlight; }
+
+	// Before taking on the next frame, waits until fewer than maxFrames are unfinished.
+	// Returns the seconds spent waiting.
+	double wait();
+
+	// Around the frame's GL commands, end() after the swap
+	void begin(unsigned long long frame);
+	void end();
+
+	// Oldest frame the GPU has finished since the last call, false if none has
+	bool retire(RetiredFrame& frame);
+
+	unsigned int outstanding() const { return (unsigned int)inFlight.size(); }
+	double cpuWaitSeconds() const { return cpuWait; }
+	double gpuIdleSeconds() const { return gpuIdle; }
+	double gpuBusySeconds() const { return gpuBusy; }
+
+	void report() const;
+
+private:
+	struct Frame {
+		unsigned long long number;
+		GLuint startQuery;
+		GLuint endQuery;
+		GLsync fence;
+	};
+
+	bool finish(bool wait);
+	GLuint allocateQuery();
+	void calibrate();
+
+	unsigned int maxInFlight;
+	Frame building = {};
+	std::deque<Frame> inFlight;
+	std::deque<RetiredFrame> retired;
+	std::vector<GLuint> freeQueries;
+
+	// GL_TIMESTAMP seconds minus glfwGetTime(), refreshed once a second
+	double gpuClockOffset = 0.0;
+	double calibrated = -1.0;
+
+	double lastGpuEnd = -1.0;
+	unsigned long long frameCount = 0;
+	unsigned int waitCount = 0;
+	double cpuWait = 0.0;
+	double gpuIdle = 0.0;
+	double gpuBusy = 0.0;
+};
+
+#endif
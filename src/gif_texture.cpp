@@ -0,0 +1,161 @@
+#include "gif_texture.h"
+
+#include "stb_image.h"
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// Browsers show frames shorter than this for the default delay, which GIFs are made to look right at
+static const int GIF_MIN_DELAY_MS = 20;
+static const int GIF_DEFAULT_DELAY_MS = 100;
+
+// GL rows go bottom up
+static void FlipRows(unsigned char* destination, const unsigned char* source, size_t rowBytes, int rows) {
+	for (int y = 0; y < rows; y++)
+		memcpy(destination + (size_t)(rows - 1 - y) * rowBytes, source + (size_t)y * rowBytes, rowBytes);
+}
+
+GifTexture::GifTexture(unsigned int layers) : layerCount(layers < 2 ? 2 : layers) {
+}
+
+GifTexture::~GifTexture() {
+	close();
+}
+
+void GifTexture::close() {
+	stbi_gif_stream_close(stream);
+	stream = nullptr;
+	if (uploads)
+		uploads->release();
+	uploads.reset();
+	if (array)
+		glDeleteTextures(1, &array);
+	array = 0;
+	file.close();
+
+	queued.clear();
+	firstLoop.clear();
+	shown = 0.0;
+	nextLayer = 0;
+	loopFrames = 0;
+	decodedCount = 0;
+	resident = false;
+}
+
+bool GifTexture::open(const char* path) {
+	close();
+	if (!file.open(path) || file.size() > INT_MAX) {
+		std::cout << "Failed to load GIF: " << path << std::endl;
+		return false;
+	}
+	stream = stbi_gif_stream_open_memory(file.data(), (int)file.size(), &width, &height);
+	if (!stream) {
+		std::cout << "Failed to load GIF: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		return false;
+	}
+
+	size_t frameBytes = (size_t)width * height * 4;
+	uploads.reset(new UploadRing(frameBytes * 2));
+	glGenTextures(1, &array);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (!decodeNext()) {
+		std::cout << "Failed to load GIF: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		return false;
+	}
+	std::cout << "GIF texture: " << path << " (" << width << "x" << height << ", " << layerCount << " layers, "
+		<< frameBytes * layerCount / 1024 << " KB)" << std::endl;
+	return true;
+}
+
+void GifTexture::update(double seconds) {
+	if (queued.empty())
+		return;
+
+	shown += seconds;
+	while (queued.size() > 1 && shown >= queued.front().seconds) {
+		shown -= queued.front().seconds;
+		if (resident)
+			queued.push_back(queued.front());
+		queued.pop_front();
+	}
+	// When decoding falls behind, hold the frame rather than skip through the next ones
+	if (queued.size() == 1 && shown > queued.front().seconds)
+		shown = queued.front().seconds;
+
+	if (!resident && queued.size() < layerCount)
+		decodeNext();
+}
+
+bool GifTexture::decodeNext() {
+	int delay = 0;
+	unsigned char* pixels = stbi_gif_stream_next(stream, &delay);
+	if (!pixels) {
+		// End of the animation, or corrupt data after the last good frame; both loop
+		if (loopFrames == 0)
+			return false;
+
+		if (loopFrames == firstLoop.size() && loopFrames <= layerCount) {
+			// Frames already shown are put back behind the queued ones, in order
+			size_t played = loopFrames - queued.size();
+			queued.insert(queued.end(), firstLoop.begin(), firstLoop.begin() + played);
+			firstLoop.clear();
+			stbi_gif_stream_close(stream);
+			stream = nullptr;
+			resident = true;
+			return true;
+		}
+
+		stbi_gif_stream_rewind(stream);
+		loopFrames = 0;
+		firstLoop.clear();
+		pixels = stbi_gif_stream_next(stream, &delay);
+		if (!pixels)
+			return false;
+	}
+
+	Frame frame;
+	frame.layer = nextLayer;
+	frame.seconds = (delay < GIF_MIN_DELAY_MS ? GIF_DEFAULT_DELAY_MS : delay) / 1000.0;
+	upload(pixels, frame.layer);
+	nextLayer = (nextLayer + 1) % layerCount;
+
+	// Only the first pass can turn out to fit; later passes start from whatever layer is next
+	if (decodedCount == loopFrames && firstLoop.size() < layerCount)
+		firstLoop.push_back(frame);
+	queued.push_back(frame);
+	loopFrames++;
+	decodedCount++;
+	return true;
+}
+
+void GifTexture::upload(const unsigned char* pixels, int layer) {
+	size_t rowBytes = (size_t)width * 4;
+	size_t frameBytes = rowBytes * height;
+	const void* source = nullptr;
+	bool staged = false;
+	if (unsigned char* staging = uploads->map(frameBytes)) {
+		FlipRows(staging, pixels, rowBytes, height);
+		staged = uploads->unmap();
+	}
+	if (staged) {
+		source = uploads->offset();
+	}
+	else {
+		flipped.resize(frameBytes);
+		FlipRows(flipped.data(), pixels, rowBytes, height);
+		source = flipped.data();
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+
+	if (staged)
+		uploads->submit();
+}
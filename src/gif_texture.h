@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef GIF_TEXTURE_H
+#define GIF_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "mapped_file.h"
+#include "upload_ring.h"
+
+struct stbi_gif_stream;
+
+// Plays an animated GIF out of a GL_TEXTURE_2D_ARRAY used as a ring of layers. Frames
+// are decoded one at a time, a little ahead of playback, into the next free layer, so
+// memory is the ring plus a few frames on the CPU however long the animation runs.
+// Animations that fit in the ring are decoded once and then only cycle through layers.
+// Sample the array at layer() with a sampler2DArray. Unlike the context-wide
+// wrappers, each GIF owns its texture and deletes it, so destroy or reopen one only
+// while the context is current.
+class GifTexture {
+public:
+	GifTexture(unsigned int layers = 4);
+	~GifTexture();
+
+	GifTexture(const GifTexture&) = delete;
+	GifTexture& operator=(const GifTexture&) = delete;
+
+	// Creates the array and uploads the first frame, replacing any GIF opened before
+	bool open(const char* path);
+
+	// Deletes the array and staging ring and closes the file
+	void close();
+
+	// Advances playback and decodes at most one frame, so a frame never pays for more
+	void update(double seconds);
+
+	GLuint texture() const { return array; }
+	int layer() const { return queued.empty() ? 0 : queued.front().layer; }
+
+	// Frames decoded since open, counting every loop until the animation is resident
+	unsigned int framesDecoded() const { return decodedCount; }
+
+private:
+	struct Frame {
+		int layer;
+		double seconds;
+	};
+
+	bool decodeNext();
+	void upload(const unsigned char* pixels, int layer);
+
+	unsigned int layerCount;
+	MappedFile file;
+	stbi_gif_stream* stream = nullptr;
+	std::unique_ptr<UploadRing> uploads;
+	std::vector<unsigned char> flipped; // only when the ring can't take a frame
+	GLuint array = 0;
+	int width = 0;
+	int height = 0;
+
+	std::deque<Frame> queued;           // front is on screen, the rest are decoded ahead
+	std::vector<Frame> firstLoop;       // timings while the whole animation might fit the ring
+	double shown = 0.0;                 // seconds the front frame has been on screen
+	unsigned int nextLayer = 0;
+	unsigned int loopFrames = 0;        // frames decoded in the current pass over the file
+	unsigned int decodedCount = 0;
+	bool resident = false;              // every frame is in the ring, the stream is closed
+};
+
+#endif
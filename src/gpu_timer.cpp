@@ -0,0 +1,56 @@
+#include "gpu_timer.h"
+
+GpuTimer::GpuTimer(unsigned int queryCount) : freeQueries(queryCount) {
+	glGenQueries((GLsizei)queryCount, freeQueries.data());
+}
+
+void GpuTimer::begin(unsigned long long tag) {
+	if (freeQueries.empty()) {
+		stallCount++;
+		finished.push_back(readOldest());
+	}
+	GLuint query = freeQueries.back();
+	freeQueries.pop_back();
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	inFlight.push_back({ query, tag });
+	open = true;
+}
+
+void GpuTimer::end() {
+	if (!open)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	open = false;
+}
+
+bool GpuTimer::poll(GpuTimerResult& result, bool wait) {
+	if (!finished.empty()) {
+		result = finished.front();
+		finished.pop_front();
+		return true;
+	}
+	// The open span can't be read until it ends
+	if (inFlight.empty() || (open && inFlight.size() == 1))
+		return false;
+
+	// Queries finish in order, so only the oldest needs asking
+	if (!wait) {
+		GLint available = 0;
+		glGetQueryObjectiv(inFlight.front().query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+	}
+	result = readOldest();
+	return true;
+}
+
+GpuTimerResult GpuTimer::readOldest() {
+	Span oldest = inFlight.front();
+	inFlight.pop_front();
+	freeQueries.push_back(oldest.query);
+
+	// Waits if the GPU hasn't got to the end of the span yet
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(oldest.query, GL_QUERY_RESULT, &nanoseconds);
+	return { oldest.tag, nanoseconds * 1e-9 };
+}
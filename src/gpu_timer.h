@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <vector>
+
+struct GpuTimerResult {
+	unsigned long long tag;
+	double seconds;
+};
+
+// Measures GPU time of spans of commands with GL_TIME_ELAPSED queries. Queries are
+// read back a few frames later, once the GPU has finished them, so timing doesn't
+// make the CPU wait. Like the upload ring, the queries go away with the context.
+class GpuTimer {
+public:
+	GpuTimer(unsigned int queryCount = 8);
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// Spans can't nest. When every query is still in flight, begin() waits for the oldest.
+	void begin(unsigned long long tag);
+	void end();
+
+	// Oldest finished span, false if none has finished or, with wait, none is left
+	bool poll(GpuTimerResult& result, bool wait = false);
+
+	// Times begin() had to wait for a query to come back
+	unsigned int stalls() const { return stallCount; }
+
+private:
+	struct Span {
+		GLuint query;
+		unsigned long long tag;
+	};
+
+	GpuTimerResult readOldest();
+
+	std::vector<GLuint> freeQueries;
+	std::deque<Span> inFlight;
+	std::deque<GpuTimerResult> finished;
+	bool open = false;
+	unsigned int stallCount = 0;
+};
+
+#endif
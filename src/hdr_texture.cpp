@@ -0,0 +1,43 @@
+#include "hdr_texture.h"
+
+#include "mapped_file.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <climits>
+#include <iostream>
+
+bool LoadHdrTexture(GLuint texture, const char* path, HdrTextureFormat format) {
+	MappedFile file;
+	if (!file.open(path) || file.size() > INT_MAX) {
+		std::cout << "Failed to load HDR texture: " << path << std::endl;
+		return false;
+	}
+
+	bool half = format == HdrTextureFormat::RGBA16F;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int width, height;
+	void* pixels = stbi_load_hdr_packed_from_memory(file.data(), (int)file.size(), &width, &height,
+		half ? STBI_hdr_rgba16f : STBI_hdr_r11g11b10f, true);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!pixels) {
+		std::cout << "Failed to load HDR texture: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		return false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (half)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, pixels);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(pixels);
+
+	// MB/s of .hdr file decoded
+	double pixelBytes = (double)width * height * (half ? 8 : 4);
+	std::cout << "HDR texture: " << path << " (" << width << "x" << height << ", " << (half ? "RGBA16F" : "R11G11B10F")
+		<< ", " << pixelBytes / (1024 * 1024) << " MB in " << elapsed << " ms, "
+		<< file.size() / 1024.0 / 1024.0 / (elapsed / 1000.0) << " MB/s)" << std::endl;
+	return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef HDR_TEXTURE_H
+#define HDR_TEXTURE_H
+
+#include <glad/glad.h>
+
+enum class HdrTextureFormat {
+	RGBA16F,      // 8 bytes per texel, alpha 1
+	R11G11B10F    // 4 bytes per texel, no sign or alpha; a quarter of the float image
+};
+
+// Loads a Radiance .hdr file into texture with a full mip chain. The RGBE pixels are
+// decoded straight to the texture format, so the 12 or 16 byte per pixel float image
+// stb_image would otherwise return is never made. Logs the decode throughput.
+bool LoadHdrTexture(GLuint texture, const char* path, HdrTextureFormat format);
+
+#endif
@@ -0,0 +1,129 @@
+#include "input.h"
+
+#include <algorithm>
+
+void Input::attach(GLFWwindow* window) {
+	glfwSetWindowUserPointer(window, this);
+	glfwSetKeyCallback(window, KeyCallback);
+	glfwSetMouseButtonCallback(window, MouseButtonCallback);
+	glfwSetCursorPosCallback(window, CursorPosCallback);
+	glfwSetScrollCallback(window, ScrollCallback);
+}
+
+void Input::start(double time) {
+	previousTime = currentTime = time;
+}
+
+void Input::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	input->push({ InputEventType::Key, key, action, mods, 0.0, 0.0, glfwGetTime(), 0 });
+}
+
+void Input::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	input->push({ InputEventType::MouseButton, button, action, mods, 0.0, 0.0, glfwGetTime(), 0 });
+}
+
+void Input::CursorPosCallback(GLFWwindow* window, double x, double y) {
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	input->push({ InputEventType::CursorPos, 0, 0, 0, x, y, glfwGetTime(), 0 });
+}
+
+void Input::ScrollCallback(GLFWwindow* window, double x, double y) {
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	input->push({ InputEventType::Scroll, 0, 0, 0, x, y, glfwGetTime(), 0 });
+}
+
+void Input::push(const InputEvent& event) {
+	InputEvent queued = event;
+	queued.id = nextId++;
+	if (!queue.push(queued))
+		droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Input::advance(double time) {
+	previousTime = currentTime;
+	currentTime = std::max(time, previousTime);
+
+	for (State& state : keys) {
+		state.held = 0.0;
+		state.presses = 0;
+	}
+	for (State& state : buttons) {
+		state.held = 0.0;
+		state.presses = 0;
+	}
+	scroll = 0.0;
+	consumedEvents.clear();
+
+	// Later events stay queued for the next interval
+	double now = glfwGetTime();
+	while (const InputEvent* event = queue.front()) {
+		if (event->time > currentTime)
+			break;
+		double age = now - event->time;
+		totalAge += age;
+		maxAge = std::max(maxAge, age);
+		eventCount++;
+		apply(*event);
+		consumedEvents.push_back(*event);
+		queue.pop();
+	}
+
+	// Keys still down were held to the end of the interval
+	for (State& state : keys) {
+		if (state.down) {
+			state.held += currentTime - state.since;
+			state.since = currentTime;
+		}
+	}
+	for (State& state : buttons) {
+		if (state.down) {
+			state.held += currentTime - state.since;
+			state.since = currentTime;
+		}
+	}
+}
+
+void Input::apply(const InputEvent& event) {
+	switch (event.type) {
+	case InputEventType::Key:
+		if (ValidKey(event.code))
+			applyState(keys[event.code], event.action, event.time);
+		break;
+	case InputEventType::MouseButton:
+		if (ValidButton(event.code))
+			applyState(buttons[event.code], event.action, event.time);
+		break;
+	case InputEventType::CursorPos:
+		cursor[0] = event.x;
+		cursor[1] = event.y;
+		break;
+	case InputEventType::Scroll:
+		scroll += event.y;
+		break;
+	}
+}
+
+void Input::applyState(State& state, int action, double time) {
+	// Events that waited past the start of the interval count from its start
+	time = std::min(std::max(time, previousTime), currentTime);
+	if (action == GLFW_PRESS && !state.down) {
+		state.down = true;
+		state.since = time;
+		state.presses++;
+	}
+	else if (action == GLFW_RELEASE && state.down) {
+		state.held += time - state.since;
+		state.down = false;
+	}
+}
+
+InputStats Input::stats() const {
+	InputStats stats;
+	stats.events = eventCount;
+	stats.dropped = droppedCount.load(std::memory_order_relaxed);
+	stats.totalAge = totalAge;
+	stats.maxAge = maxAge;
+	return stats;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <vector>
+
+#include "spsc_queue.h"
+
+enum class InputEventType {
+	Key,
+	MouseButton,
+	CursorPos,
+	Scroll
+};
+
+struct InputEvent {
+	InputEventType type;
+	int code;       // key or mouse button
+	int action;     // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+	int mods;
+	double x;       // cursor position or scroll offset
+	double y;
+	double time;    // glfwGetTime() when GLFW delivered the event
+	unsigned int id; // order the events were queued in, to follow one through a frame
+};
+
+struct InputStats {
+	unsigned long long events = 0;
+	unsigned long long dropped = 0;  // the queue was full
+	double totalAge = 0.0;           // seconds from delivery to being consumed, summed
+	double maxAge = 0.0;
+};
+
+// Keyboard and mouse state built from GLFW callbacks instead of polling. Callbacks
+// timestamp each event and push it into a lock free queue; advance() consumes events
+// up to a time, so a press and release between two frames still counts and held keys
+// are measured in seconds rather than in frames.
+class Input {
+public:
+	Input() = default;
+
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	// Installs the callbacks and takes the window user pointer
+	void attach(GLFWwindow* window);
+
+	// Sets where the first interval starts, events stamped before it count from there
+	void start(double time);
+
+	// Queues an event as if a callback had delivered it, for replaying recorded input.
+	// Only one thread may push, so don't mix with attach().
+	void push(const InputEvent& event);
+
+	// Consumes queued events stamped up to time and starts a new interval at the
+	// previous call. Call from one thread only.
+	void advance(double time);
+
+	bool down(int key) const { return ValidKey(key) && keys[key].down; }
+
+	// Seconds key was down during the last interval
+	double heldSeconds(int key) const { return ValidKey(key) ? keys[key].held : 0.0; }
+
+	// Presses during the last interval, not counting repeats
+	int presses(int key) const { return ValidKey(key) ? keys[key].presses : 0; }
+
+	bool buttonDown(int button) const { return ValidButton(button) && buttons[button].down; }
+	int buttonPresses(int button) const { return ValidButton(button) ? buttons[button].presses : 0; }
+
+	double cursorX() const { return cursor[0]; }
+	double cursorY() const { return cursor[1]; }
+
+	// Scroll offset summed over the last interval
+	double scrollY() const { return scroll; }
+
+	double intervalStart() const { return previousTime; }
+	double intervalEnd() const { return currentTime; }
+
+	// Events consumed by the last advance(), oldest first
+	const std::vector<InputEvent>& consumed() const { return consumedEvents; }
+
+	InputStats stats() const;
+
+private:
+	struct State {
+		bool down = false;
+		double since = 0.0;   // when the current hold started within the interval
+		double held = 0.0;
+		int presses = 0;
+	};
+
+	static bool ValidKey(int key) { return key >= 0 && key <= GLFW_KEY_LAST; }
+	static bool ValidButton(int button) { return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST; }
+
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void CursorPosCallback(GLFWwindow* window, double x, double y);
+	static void ScrollCallback(GLFWwindow* window, double x, double y);
+
+	void apply(const InputEvent& event);
+	void applyState(State& state, int action, double time);
+
+	SpscQueue<InputEvent, 1024> queue;
+	std::atomic<unsigned long long> droppedCount{ 0 };
+	unsigned int nextId = 0;                // producer side only
+
+	// Consumer side only
+	State keys[GLFW_KEY_LAST + 1];
+	State buttons[GLFW_MOUSE_BUTTON_LAST + 1];
+	double cursor[2] = { 0.0, 0.0 };
+	double scroll = 0.0;
+	std::vector<InputEvent> consumedEvents;
+	double previousTime = 0.0;
+	double currentTime = 0.0;
+	unsigned long long eventCount = 0;
+	double totalAge = 0.0;
+	double maxAge = 0.0;
+};
+
+#endif
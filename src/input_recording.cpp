@@ -0,0 +1,157 @@
+#include "input_recording.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+static const char LOG_MAGIC[8] = { 'I', 'N', 'P', 'U', 'T', 'L', 'O', 'G' };
+static const uint32_t LOG_VERSION = 1;
+
+// Record tags
+static const uint8_t LOG_FRAME = 'F';
+static const uint8_t LOG_EVENT = 'E';
+
+struct LogHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	double simulationRate;
+	double startTime;
+};
+
+// Events are written field by field, positions only for the events that have them.
+// Times are written whole, rounding them would change which step sees an event.
+struct LogEvent {
+	uint8_t type;
+	int8_t action;
+	int16_t code;
+	int32_t mods;
+	double time;
+};
+
+template <typename T>
+static void Write(std::ofstream& file, const T& value) {
+	file.write((const char*)&value, sizeof(value));
+}
+
+template <typename T>
+static bool Read(const std::vector<unsigned char>& data, size_t& position, T& value) {
+	if (data.size() - position < sizeof(value))
+		return false;
+	memcpy(&value, data.data() + position, sizeof(value));
+	position += sizeof(value);
+	return true;
+}
+
+static bool HasPosition(InputEventType type) {
+	return type == InputEventType::CursorPos || type == InputEventType::Scroll;
+}
+
+bool InputRecorder::open(const char* logPath, double simulationRate, double startTime) {
+	path = logPath;
+	file.open(logPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "Failed to write input log: " << logPath << std::endl;
+		return false;
+	}
+
+	LogHeader header;
+	memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+	header.version = LOG_VERSION;
+	header.reserved = 0;
+	header.simulationRate = simulationRate;
+	header.startTime = startTime;
+	Write(file, header);
+	return true;
+}
+
+void InputRecorder::frame(double time) {
+	if (!file.is_open())
+		return;
+	Write(file, LOG_FRAME);
+	Write(file, time);
+	frameCount++;
+}
+
+void InputRecorder::events(const std::vector<InputEvent>& consumed) {
+	if (!file.is_open())
+		return;
+	for (const InputEvent& event : consumed) {
+		LogEvent logged = { (uint8_t)event.type, (int8_t)event.action, (int16_t)event.code, event.mods, event.time };
+		Write(file, LOG_EVENT);
+		Write(file, logged);
+		if (HasPosition(event.type)) {
+			Write(file, event.x);
+			Write(file, event.y);
+		}
+	}
+	eventCount += consumed.size();
+}
+
+bool InputRecorder::close() {
+	if (!file.is_open())
+		return true;
+	file.close();
+	if (!file) {
+		std::cout << "Failed to write input log: " << path << std::endl;
+		return false;
+	}
+	std::cout << "Input log: " << path << " (" << frameCount << " frames, " << eventCount << " events)" << std::endl;
+	return true;
+}
+
+bool InputReplay::open(const char* path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to read input log: " << path << std::endl;
+		return false;
+	}
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	LogHeader header;
+	position = 0;
+	if (!Read(data, position, header) || memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || header.version != LOG_VERSION) {
+		std::cout << "Not an input log: " << path << std::endl;
+		data.clear();
+		return false;
+	}
+	rate = header.simulationRate;
+	start = header.startTime;
+	return true;
+}
+
+bool InputReplay::nextFrame(double& time) {
+	// Events the last frame's steps didn't reach are still handed over
+	frameEvents.erase(frameEvents.begin(), frameEvents.begin() + nextEvent);
+	nextEvent = 0;
+
+	uint8_t tag;
+	if (!Read(data, position, tag) || tag != LOG_FRAME || !Read(data, position, time))
+		return false;
+
+	// Everything up to the next frame record belongs to this frame
+	size_t mark = position;
+	while (Read(data, position, tag) && tag == LOG_EVENT) {
+		LogEvent logged;
+		InputEvent event = {};
+		if (!Read(data, position, logged))
+			return false;
+		event.type = (InputEventType)logged.type;
+		event.action = logged.action;
+		event.code = logged.code;
+		event.mods = logged.mods;
+		event.time = logged.time;
+		if (HasPosition(event.type) && !(Read(data, position, event.x) && Read(data, position, event.y)))
+			return false;
+		frameEvents.push_back(event);
+		mark = position;
+	}
+	position = mark;
+	frameCount++;
+	return true;
+}
+
+void InputReplay::feed(Input& input, double time) {
+	while (nextEvent < frameEvents.size() && frameEvents[nextEvent].time <= time)
+		input.push(frameEvents[nextEvent++]);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "input.h"
+
+// Writes a run's frame clock and the input events it consumed to a compact binary
+// log. Replaying the log through the same fixed timestep makes every step see the
+// same events at the same simulated times, so the frames drawn are the same too.
+class InputRecorder {
+public:
+	InputRecorder() = default;
+
+	InputRecorder(const InputRecorder&) = delete;
+	InputRecorder& operator=(const InputRecorder&) = delete;
+
+	// startTime is where the timestep and the input's first interval start
+	bool open(const char* path, double simulationRate, double startTime);
+	bool isOpen() const { return file.is_open(); }
+
+	// The time a frame handed to the timestep, then the events its steps consumed
+	void frame(double time);
+	void events(const std::vector<InputEvent>& consumed);
+
+	// Flushes the log, false if anything failed to write
+	bool close();
+
+	unsigned long long frames() const { return frameCount; }
+	unsigned long long eventsWritten() const { return eventCount; }
+
+private:
+	std::ofstream file;
+	std::string path;
+	unsigned long long frameCount = 0;
+	unsigned long long eventCount = 0;
+};
+
+// Reads a log written by InputRecorder back frame by frame
+class InputReplay {
+public:
+	InputReplay() = default;
+
+	InputReplay(const InputReplay&) = delete;
+	InputReplay& operator=(const InputReplay&) = delete;
+
+	bool open(const char* path);
+
+	double simulationRate() const { return rate; }
+	double startTime() const { return start; }
+
+	// Time of the next recorded frame, false at the end of the log
+	bool nextFrame(double& time);
+
+	// Queues the current frame's events stamped up to time, call before each step
+	void feed(Input& input, double time);
+
+	unsigned long long frames() const { return frameCount; }
+
+private:
+	std::vector<unsigned char> data;
+	size_t position = 0;
+	size_t nextEvent = 0;
+	std::vector<InputEvent> frameEvents;
+	double rate = 0.0;
+	double start = 0.0;
+	unsigned long long frameCount = 0;
+};
+
+#endif
@@ -1,15 +1,28 @@
 #include "key_handler.h";
 
-void ProcessInput(GLFWwindow* window, float* mixAmount) {
-	
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, true);
+#include <algorithm>
 
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-		(*mixAmount) += 0.1;
-	}
+// Degrees per second a held arrow key changes the field of view by, which is what
+// the old 0.1 per frame came to at 60 frames per second
+static const float FOV_SPEED = 6.0f;
+static const float FOV_MIN = 1.0f;
+static const float FOV_MAX = 120.0f;
+
+// A tap moves it at least as far as one frame of holding used to
+static const double FOV_TAP_SECONDS = 1.0 / 60.0;
+
+static double HeldOrTapped(const Input& input, int key) {
+	return std::max(input.heldSeconds(key), input.presses(key) * FOV_TAP_SECONDS);
+}
+
+void ProcessInput(const Input& input, float* mixAmount, std::atomic<bool>* quit) {
 	
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-		(*mixAmount) -= 0.1;
+	if (input.presses(GLFW_KEY_ESCAPE) > 0) {
+		quit->store(true);
+		glfwPostEmptyEvent();
 	}
+
+	double held = HeldOrTapped(input, GLFW_KEY_UP) - HeldOrTapped(input, GLFW_KEY_DOWN);
+	if (held != 0.0)
+		(*mixAmount) = std::min(std::max((*mixAmount) + FOV_SPEED * (float)held, FOV_MIN), FOV_MAX);
 }
\ No newline at end of file
@@ -3,10 +3,15 @@
 #ifndef KEY_HANDLER_H
 #define KEY_HANDLER_H
 
+#include "input.h"
 #include "shader.h";
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 
-void ProcessInput (GLFWwindow* window, float* mixAmount);
+
+// Applies the input consumed by the last Input::advance(), scaled by how long keys were held.
+// Escape sets quit and wakes the main thread, the only one that may touch the window.
+void ProcessInput (const Input& input, float* mixAmount, std::atomic<bool>* quit);
 
 #endif
@@ -0,0 +1,132 @@
+#include "latency_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static const double LATENCY_REPORT_SECONDS = 1.0;
+
+// Run-wide histogram bins, latencies longer than the last bin land in it
+static const double LATENCY_BIN_SECONDS = 0.0001;
+static const unsigned int LATENCY_BIN_COUNT = 2000;
+
+LatencyHistogram::LatencyHistogram() : bins(LATENCY_BIN_COUNT, 0) {
+}
+
+void LatencyHistogram::add(double seconds) {
+	seconds = std::max(seconds, 0.0);
+	count++;
+	longest = std::max(longest, seconds);
+	bins[std::min((size_t)(seconds / LATENCY_BIN_SECONDS), bins.size() - 1)]++;
+}
+
+double LatencyHistogram::percentile(double fraction) const {
+	unsigned long long wanted = (unsigned long long)std::ceil(fraction * count), seen = 0;
+	for (size_t i = 0; i < bins.size(); i++) {
+		seen += bins[i];
+		if (seen >= wanted && seen > 0)
+			return i + 1 == bins.size() ? longest : std::min(longest, (i + 1) * LATENCY_BIN_SECONDS);
+	}
+	return longest;
+}
+
+static void Add(std::vector<double>& samples, double seconds) {
+	samples.push_back(seconds);
+}
+
+static void Add(LatencyHistogram& samples, double seconds) {
+	samples.add(seconds);
+}
+
+// One event's stages, and whether it's the slowest yet
+template <typename Samples>
+static void Record(LatencyStages<Samples>& stages, unsigned int id, unsigned long long frame,
+	double time, double simulated, double submitted, double swapped, double completed) {
+	if (completed - time > stages.slowest) {
+		stages.slowest = completed - time;
+		stages.slowestId = id;
+		stages.slowestFrame = frame;
+	}
+	Add(stages.simulated, simulated - time);
+	Add(stages.submitted, submitted - time);
+	Add(stages.swapped, swapped - time);
+	Add(stages.completed, completed - time);
+}
+
+static double Percentile(std::vector<double> values, double fraction) {
+	if (values.empty())
+		return 0.0;
+	size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index] * 1000.0;
+}
+
+static double Percentile(const LatencyHistogram& samples, double fraction) {
+	return samples.percentile(fraction) * 1000.0;
+}
+
+template <typename Samples>
+static void Print(const char* label, const LatencyStages<Samples>& stages, unsigned long long frames) {
+	std::cout << label << ": " << stages.simulated.size() << " events over " << frames << " frames, ms p50/p95/p99";
+	const char* names[] = { "simulated", "submitted", "swapped", "GPU done" };
+	const Samples* values[] = { &stages.simulated, &stages.submitted, &stages.swapped, &stages.completed };
+	for (int i = 0; i < 4; i++) {
+		std::cout << (i ? ", " : " ") << names[i] << " " << Percentile(*values[i], 0.5) << "/"
+			<< Percentile(*values[i], 0.95) << "/" << Percentile(*values[i], 0.99);
+	}
+	std::cout << ", slowest event #" << stages.slowestId << " in frame " << stages.slowestFrame << std::endl;
+}
+
+void LatencyTracker::consumed(unsigned int id, double time, double simulated) {
+	building.events.push_back({ id, time, simulated });
+}
+
+void LatencyTracker::submitted(double now) {
+	building.submitted = now;
+}
+
+void LatencyTracker::swapped(unsigned long long frame, double now) {
+	building.number = frame;
+	building.swapped = now;
+	swappedFrames.push_back(std::move(building));
+	building = Frame();
+}
+
+void LatencyTracker::completed(unsigned long long frame, double time) {
+	// Frames finish in order, so anything older than this one is gone for good
+	while (!swappedFrames.empty() && swappedFrames.front().number < frame)
+		swappedFrames.pop_front();
+	if (swappedFrames.empty() || swappedFrames.front().number != frame)
+		return;
+	Frame& done = swappedFrames.front();
+
+	// The GPU can't finish before the swap, calibration error aside
+	time = std::max(time, done.swapped);
+
+	for (const TrackedEvent& event : done.events) {
+		Record(window, event.id, done.number, event.time, event.simulated, done.submitted, done.swapped, time);
+		Record(total, event.id, done.number, event.time, event.simulated, done.submitted, done.swapped, time);
+	}
+	if (!done.events.empty()) {
+		windowFrames++;
+		totalFrames++;
+	}
+	swappedFrames.pop_front();
+}
+
+void LatencyTracker::update(double now) {
+	if (windowStart == 0.0)
+		windowStart = now;
+	if (now - windowStart < LATENCY_REPORT_SECONDS)
+		return;
+	if (!window.simulated.empty())
+		Print("Latency", window, windowFrames);
+	window = LatencyStages<std::vector<double>>();
+	windowFrames = 0;
+	windowStart = now;
+}
+
+void LatencyTracker::report() const {
+	if (total.simulated.size())
+		Print("Input latency", total, totalFrames);
+}
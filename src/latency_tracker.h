@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include <deque>
+#include <vector>
+
+// Latencies in fixed bins, so percentiles over a whole run take the same memory
+// however long it goes
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void add(double seconds);
+	unsigned long long size() const { return count; }
+
+	// In seconds, rounded up to the end of its bin
+	double percentile(double fraction) const;
+
+private:
+	unsigned long long count = 0;
+	double longest = 0.0;
+	std::vector<unsigned int> bins;
+};
+
+// Latencies of the events finished in one report, in seconds from delivery. The
+// once a second report keeps exact samples, the whole run keeps histograms.
+template <typename Samples>
+struct LatencyStages {
+	Samples simulated;              // consumed by a simulation step
+	Samples submitted;              // the frame showing it was submitted
+	Samples swapped;                // glfwSwapBuffers returned
+	Samples completed;              // the GPU finished the frame, the closest to photons GL can see
+	double slowest = -1.0;          // event that took longest to complete, and its frame
+	unsigned int slowestId = 0;
+	unsigned long long slowestFrame = 0;
+};
+
+// Follows input events by id through the frame that shows them: simulation,
+// submission, the swap and the GPU finishing the frame, which FramesInFlight
+// reports. Only the render thread calls in, the simulation thread's part arrives
+// with the frame packet.
+class LatencyTracker {
+public:
+	LatencyTracker() = default;
+
+	LatencyTracker(const LatencyTracker&) = delete;
+	LatencyTracker& operator=(const LatencyTracker&) = delete;
+
+	// An event the frame being submitted consumed, by id, when it was delivered and
+	// when a simulation step took it
+	void consumed(unsigned int id, double time, double simulated);
+
+	// Around glfwSwapBuffers
+	void submitted(double now);
+	void swapped(unsigned long long frame, double now);
+
+	// When the GPU finished a swapped frame
+	void completed(unsigned long long frame, double time);
+
+	// Prints a line of percentiles once a second
+	void update(double now);
+
+	// Percentiles over the whole run
+	void report() const;
+
+private:
+	struct TrackedEvent {
+		unsigned int id;
+		double time;
+		double simulated;
+	};
+
+	struct Frame {
+		unsigned long long number = 0;
+		std::vector<TrackedEvent> events;
+		double submitted = 0.0;
+		double swapped = 0.0;
+	};
+
+	Frame building;
+	std::deque<Frame> swappedFrames;
+
+	LatencyStages<std::vector<double>> window;
+	LatencyStages<LatencyHistogram> total;
+	unsigned long long windowFrames = 0;
+	unsigned long long totalFrames = 0;
+	double windowStart = 0.0;
+};
+
+#endif
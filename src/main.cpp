@@ -1,36 +1,196 @@
 #include <glad/glad.h>
 #include <GlFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "camera.h"
+#include "decode_benchmark.h"
+#include "dynamic_resolution.h"
+#include "fixed_timestep.h"
+#include "frame_packet.h"
+#include "frame_pacer.h"
+#include "frame_queue.h"
+#include "frames_in_flight.h"
+#include "frame_timings.h"
+#include "gif_texture.h"
+#include "gpu_timer.h"
+#include "hdr_texture.h"
+#include "input.h"
+#include "input_recording.h"
 #include "key_handler.h"
+#include "latency_tracker.h"
+#include "render_target_pool.h"
 #include "shader.h"
-#include "stb_image.h"
+#include "simulation.h"
+#include "texture_cache.h"
+#include "texture_streamer.h"
+#include "upload_benchmark.h"
 
 const int VIEWPORT_HEIGHT = 600;
 const int VIEWPORT_WIDTH = 800;
 
+// Simulation steps per second, frames draw between the last two steps
+const double SIMULATION_RATE = 120.0;
+
+// Mip data allowed on the GPU at once, finer levels are evicted past this
+const size_t TEXTURE_VRAM_BUDGET = 64 * 1024 * 1024;
+
 float FOV = 45;
 
+// Near and far planes of the projection
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// Radius of the sphere around a unit cube, for frustum culling
+const float CUBE_BOUNDING_RADIUS = 0.8660254f;
+
 float mixAmount = 0.0f;
 
+// Weight of the overlay while a --gif animation or --hdr image shows over the container
+const float OVERLAY_MIX_AMOUNT = 0.5f;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
-unsigned char* loadTexture(const char* texturePath, GLenum format);
+// Set on the main thread by the callback, applied by the render thread and read
+// by the simulation thread for the aspect ratio
+std::atomic<int> framebufferWidth(VIEWPORT_WIDTH);
+std::atomic<int> framebufferHeight(VIEWPORT_HEIGHT);
+
+// Set by Escape, the end of a replay or the window closing. The threads poll it and
+// only the main thread touches glfwWindowShouldClose, which isn't safe to share.
+std::atomic<bool> quitRequested(false);
 
 // SHADERS
 const char* vertexShaderPath = "src/shader.vert";
 const char* fragmentShaderPath = "src/shader.frag";
+const char* upscaleVertexShaderPath = "src/upscale.vert";
+const char* upscaleFragmentShaderPath = "src/upscale.frag";
 
 // TEXTURES
+const char* textureDirectory = "resources/textures";
 const char* containerTexturePath = "resources/textures/container.jpg";
 const char* awesomeFaceTexturePath = "resources/textures/awesomeface.png";
 
-int main()
+// Decoded textures from previous runs, memory mapped on startup
+const char* textureCachePath = "texture_cache.bin";
+
+// Images of every format stb_image decodes, for --benchmark-decode
+const char* benchmarkDirectory = "resources/benchmark";
+
+// Per frame CPU and GPU times of --replay, when no other file is given
+const char* replayTimingsPath = "replay_frames.csv";
+
+// Frame time histogram of every run
+const char* framePacingPath = "frame_pacing.csv";
+
+// Resolution of every frame with --dynamic-resolution
+const char* dynamicResolutionPath = "dynamic_resolution.csv";
+
+// Frames the GPU may be behind by, --frames-in-flight overrides it
+const unsigned int FRAMES_IN_FLIGHT = 2;
+const unsigned int LOW_LATENCY_FRAMES_IN_FLIGHT = 1;
+
+// Frame packets the simulation may be ahead of the render thread by
+const size_t FRAME_QUEUE_DEPTH = 2;
+const size_t LOW_LATENCY_FRAME_QUEUE_DEPTH = 1;
+
+// Offscreen targets follow the window once its size has held this long, so dragging
+// an edge doesn't allocate a target for every size passed through
+const double RESIZE_SETTLE_SECONDS = 0.2;
+
+// Frames a pooled render target may go unused before it is deleted
+const unsigned int RENDER_TARGET_IDLE_FRAMES = 8;
+
+int main(int argc, char** argv)
 {
+    // Decode benchmark only, no window: --benchmark-decode [directory]
+    if (argc > 1 && strcmp(argv[1], "--benchmark-decode") == 0) {
+        unsigned int threads = std::thread::hardware_concurrency();
+        ThreadPool pool(threads > 1 ? threads - 1 : 1);
+        RunDecodeBenchmark(argc > 2 ? argv[2] : benchmarkDirectory, pool);
+        return 0;
+    }
+
+    // Texture upload benchmark only, in a hidden window: --benchmark-upload
+    bool benchmarkUpload = argc > 1 && strcmp(argv[1], "--benchmark-upload") == 0;
+
+    // Record input while running: --record log
+    // Replay it without showing a window, as fast as frames draw: --replay log [timings.csv]
+    // Keep the GPU at most a frame behind, so input is sampled later: --low-latency
+    // When frames start: --pacing vsync|adaptive|cap|uncapped, --fps rate for cap
+    // Frames the GPU may be behind by, 0 for no limit: --frames-in-flight count
+    // Lower the resolution to keep the scene in a GPU budget: --dynamic-resolution ms, --upscale bilinear|sharp
+    // Play an animated GIF in place of the face texture: --gif path
+    // Show a Radiance .hdr image in place of the face texture: --hdr path [rgba16f|r11g11b10f]
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* timingsPath = replayTimingsPath;
+    bool lowLatency = false;
+    PacingMode pacing = PacingMode::VSync;
+    double pacingRate = 60.0;
+    unsigned int framesInFlightLimit = FRAMES_IN_FLIGHT;
+    double resolutionBudget = 0.0;
+    UpscaleFilter upscaleFilter = UpscaleFilter::Sharpened;
+    const char* gifPath = NULL;
+    const char* hdrPath = NULL;
+    HdrTextureFormat hdrFormat = HdrTextureFormat::R11G11B10F;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                timingsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            lowLatency = true;
+        else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "adaptive") == 0)
+                pacing = PacingMode::AdaptiveVSync;
+            else if (strcmp(mode, "cap") == 0)
+                pacing = PacingMode::Capped;
+            else if (strcmp(mode, "uncapped") == 0)
+                pacing = PacingMode::Uncapped;
+            else
+                pacing = PacingMode::VSync;
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            pacingRate = std::max(1.0, atof(argv[++i]));
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+            framesInFlightLimit = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc)
+            resolutionBudget = atof(argv[++i]) / 1000.0;
+        else if (strcmp(argv[i], "--upscale") == 0 && i + 1 < argc)
+            upscaleFilter = strcmp(argv[++i], "bilinear") == 0 ? UpscaleFilter::Bilinear : UpscaleFilter::Sharpened;
+        else if (strcmp(argv[i], "--gif") == 0 && i + 1 < argc)
+            gifPath = argv[++i];
+        else if (strcmp(argv[i], "--hdr") == 0 && i + 1 < argc) {
+            hdrPath = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+                hdrFormat = strcmp(argv[++i], "rgba16f") == 0 ? HdrTextureFormat::RGBA16F : HdrTextureFormat::R11G11B10F;
+        }
+    }
+
+    // Replays draw as fast as they can, at full resolution so every run draws the same pixels
+    if (replayPath) {
+        pacing = PacingMode::Uncapped;
+        resolutionBudget = 0.0;
+    }
+
+    InputReplay replay;
+    if (replayPath && !replay.open(replayPath))
+        return -1;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -42,6 +202,8 @@ int main()
 
     // Init Window 
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+    if (replayPath || benchmarkUpload)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
     GLFWwindow* window = glfwCreateWindow(VIEWPORT_WIDTH, VIEWPORT_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -59,16 +221,39 @@ int main()
     printf("OpenGL Version:%s\n", glGetString(GL_VERSION));
     printf("GLSL Version  :%s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 
+    if (benchmarkUpload) {
+        RunUploadBenchmark();
+        glfwTerminate();
+        return 0;
+    }
+
 
     // Setup the window
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+    // Keys and mouse arrive through callbacks, timestamped, and are consumed once a step.
+    // A replay feeds recorded events instead.
+    Input input;
+    if (!replayPath)
+        input.attach(window);
+
     // Configuration
     glEnable(GL_DEPTH_TEST);
    
     // Load shaders
     Shader shapeShader(vertexShaderPath, fragmentShaderPath);
+
+    // Textures are decoded in the background and streamed in smallest mip first.
+    // The cache is declared first so its mapping outlives the streamer.
+    TextureCache textureCache(textureCachePath);
+    TextureStreamerConfig streamerConfig;
+    streamerConfig.vramBudget = TEXTURE_VRAM_BUDGET;
+    streamerConfig.cache = &textureCache;
+    TextureStreamer textureStreamer(streamerConfig);
+
+    // Headers only, so storage, load order and the budget are known before decoding
+    textureStreamer.scanInventory(textureDirectory);
    
 
     // Cube - uses element buffer object
@@ -157,7 +342,7 @@ int main()
     /*glEnableVertexAttribArray(2);*/
 
 
-    // Generate, Bind and load texture
+    // Generate, Bind and stream texture
     unsigned int texture1, texture2;
 
     // Set the texture wrapping / filtering for texture 1
@@ -168,7 +353,7 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    unsigned char* containerTextureData = loadTexture(containerTexturePath, GL_RGB);
+    textureStreamer.stream(texture1, containerTexturePath);
 
     // Set the texture wrapping / filtering for texture 2
     glGenTextures(1, &texture2);
@@ -178,76 +363,323 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    unsigned char* awesomefaceTextureData = loadTexture(awesomeFaceTexturePath, GL_RGBA);
+    if (hdrPath && LoadHdrTexture(texture2, hdrPath, hdrFormat)) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        mixAmount = OVERLAY_MIX_AMOUNT;
+    }
+    else
+        textureStreamer.stream(texture2, awesomeFaceTexturePath);
 
     shapeShader.use();
     shapeShader.setInt("texture1", 0);
     shapeShader.setInt("texture2", 1);
+    shapeShader.setInt("animation", 2);
+    shapeShader.setInt("animationLayer", -1);
+
+    // Frames go up a few at a time from the render thread as the animation plays
+    std::unique_ptr<GifTexture> animation;
+    if (gifPath) {
+        animation.reset(new GifTexture());
+        if (!animation->open(gifPath))
+            animation.reset();
+        else
+            mixAmount = OVERLAY_MIX_AMOUNT;
+    }
 
+    // The scene draws offscreen and is upscaled when it has a GPU budget
+    Shader upscaleShader(upscaleVertexShaderPath, upscaleFragmentShaderPath);
+    RenderTargetPool renderTargets(RENDER_TARGET_IDLE_FRAMES);
+    std::unique_ptr<DynamicResolution> dynamicResolution;
+    if (resolutionBudget > 0.0) {
+        DynamicResolutionConfig resolutionConfig;
+        resolutionConfig.gpuBudget = resolutionBudget;
+        resolutionConfig.filter = upscaleFilter;
+        dynamicResolution.reset(new DynamicResolution(resolutionConfig, upscaleShader, renderTargets, VIEWPORT_WIDTH, VIEWPORT_HEIGHT));
+        dynamicResolution->openLog(dynamicResolutionPath);
+    }
 
     // WIREFRAME MODE
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     
-    //glfwSwapInterval(0);
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // input
-        // This is incredibly unpreferable and requires a rework
-        ProcessInput(window, &FOV);
-
-        //rendering commands here
-        // Set the background color
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shapeShader.use();
-
-        // Matrices
-        glm::mat4 view = glm::mat4(1.0f);
-        view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f)); // Move world away from view, negative z is away
-
-        std::cout << FOV << std::endl;
-
-
-        glm::mat4 projection;
-        projection = glm::perspective(glm::radians(FOV), (float)VIEWPORT_WIDTH / (float)VIEWPORT_HEIGHT, 0.1f, 100.0f);
-
-
-        int viewLoc = glGetUniformLocation(shapeShader.ID, "view");
-        int projectionLoc = glGetUniformLocation(shapeShader.ID, "projection");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view)); 
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Blending
-        shapeShader.setFloat("mixAmount", mixAmount);
- 
-        // Bindings
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-        glBindVertexArray(VAO);
-
-        // Draw
-        for (unsigned int i = 0; i < 10; i++) {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            float angle = 20.0f * i;
-            if (i % 3 == 0) angle = glfwGetTime() * 25.0f;
-            model = glm::rotate(model, glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
-            shapeShader.setMat4("model", model);
-
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+    // The scene moves in fixed steps however fast frames come. A replay runs the
+    // recorded frame clock through the recorded rate, so every step comes out the same.
+    SimulationState previousState, currentState;
+    currentState.fov = FOV;
+    previousState = currentState;
+    double startTime = replayPath ? replay.startTime() : glfwGetTime();
+    FixedTimestep timestep(replayPath ? replay.simulationRate() : SIMULATION_RATE);
+    timestep.accumulate(startTime);
+    input.start(startTime);
+
+    InputRecorder recorder;
+    if (recordPath)
+        recorder.open(recordPath, SIMULATION_RATE, startTime);
+
+    // Follows live input to the end of the frame that shows it
+    LatencyTracker latency;
+    FramesInFlight framesInFlight(lowLatency ? LOW_LATENCY_FRAMES_IN_FLIGHT : framesInFlightLimit);
+
+    FrameTimings frameTimings;
+    GpuTimer gpuTimer;
+    FramePacer pacer(pacing, pacingRate);
+    pacer.apply();
+
+    // Built by the simulation thread, each packet carries a copy
+    Camera camera;
+    camera.setPerspective(FOV, (float)VIEWPORT_WIDTH / (float)VIEWPORT_HEIGHT, NEAR_PLANE, FAR_PLANE);
+    camera.setPose(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // Move world away from view, negative z is away
+    unsigned int culledInstances = 0;
+
+    // Uploaded by the render thread when the packet's camera changed
+    CameraUniforms cameraUniforms(shapeShader);
+
+    // The simulation thread builds frame packets and the render thread, which owns
+    // the GL context from here on, draws them. The main thread only handles events.
+    FrameQueue packets(lowLatency ? LOW_LATENCY_FRAME_QUEUE_DEPTH : FRAME_QUEUE_DEPTH);
+    glfwMakeContextCurrent(NULL);
+
+    std::thread simulationThread([&] {
+        unsigned long long frame = 0;
+        while (!quitRequested.load()) {
+            // Input is gathered once the frame is due and the queue has room
+            pacer.pace();
+
+            double frameTime = glfwGetTime();
+            if (replayPath && !replay.nextFrame(frameTime))
+                break;
+            recorder.frame(frameTime);
+
+            std::shared_ptr<FramePacket> packet = std::make_shared<FramePacket>();
+            packet->frame = frame++;
+
+            // input and simulation, each step sees the events up to its end
+            timestep.accumulate(frameTime);
+            while (timestep.consume()) {
+                previousState = currentState;
+
+                // The frame's last step takes events up to the frame time too, instead of
+                // leaving those newer than the step for the next frame
+                double inputTime = timestep.pending() ? timestep.time() : frameTime;
+                replay.feed(input, inputTime);
+                input.advance(inputTime);
+                recorder.events(input.consumed());
+                if (!replayPath) {
+                    double consumed = glfwGetTime();
+                    for (const InputEvent& event : input.consumed())
+                        packet->inputs.push_back({ event.id, event.time, consumed });
+                }
+                ProcessInput(input, &currentState.fov, &quitRequested);
+                Simulate(currentState, timestep.step());
+                packet->steps++;
+            }
+            packet->state = Interpolate(previousState, currentState, timestep.alpha());
+            FOV = packet->state.fov;
+
+            // Matrices, rebuilt only when the FOV or aspect changed. A minimized window
+            // has no size, keep the last aspect until it comes back.
+            camera.setFov(FOV);
+            int width = framebufferWidth.load(), height = framebufferHeight.load();
+            if (width > 0 && height > 0)
+                camera.setAspect((float)width / (float)height);
+            camera.update();
+            packet->camera = camera;
+
+            // Blending
+            packet->mixAmount = mixAmount;
+
+            for (unsigned int i = 0; i < 10; i++) {
+                if (!camera.visible(cubePositions[i], CUBE_BOUNDING_RADIUS)) {
+                    culledInstances++;
+                    continue;
+                }
+
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, cubePositions[i]);
+                float angle = 20.0f * i;
+                if (i % 3 == 0) angle = packet->state.spinAngle;
+                model = glm::rotate(model, glm::radians(angle), glm::vec3(0.5f, 1.0f, 0.0f));
+
+                // Each face is a unit square, so half an edge covers the texture
+                packet->instances.push_back({ model, cubePositions[i], 0.5f });
+            }
+
+            if (!packets.push(std::move(packet)))
+                break;
         }
 
+        // Replays end on their own, and the main thread may be waiting for events
+        packets.close();
+        quitRequested.store(true);
+        glfwPostEmptyEvent();
+    });
+
+    std::thread renderThread([&] {
+        glfwMakeContextCurrent(window);
+        int viewportWidth = VIEWPORT_WIDTH, viewportHeight = VIEWPORT_HEIGHT;
+        double resizedAt = 0.0;
+        double animationTime = -1.0;
+
+        // Render loop
+        while (true) {
+            // Waiting on the GPU first keeps the simulation from starting the next frame early
+            framesInFlight.wait();
+            std::shared_ptr<const FramePacket> packet = packets.pop();
+            if (!packet)
+                break;
+            double frameStart = glfwGetTime();
+
+            // Resizes arrive on the main thread, which can't touch GL
+            int width = framebufferWidth.load(), height = framebufferHeight.load();
+            if (width != viewportWidth || height != viewportHeight) {
+                glViewport(0, 0, width, height);
+                viewportWidth = width;
+                viewportHeight = height;
+                resizedAt = frameStart;
+            }
+            if (dynamicResolution && (dynamicResolution->fullWidth() != viewportWidth || dynamicResolution->fullHeight() != viewportHeight)
+                && viewportWidth > 0 && viewportHeight > 0 && frameStart - resizedAt >= RESIZE_SETTLE_SECONDS)
+                dynamicResolution->resize(viewportWidth, viewportHeight);
+
+            framesInFlight.begin(packet->frame);
+            if (replayPath)
+                gpuTimer.begin(packet->frame);
+
+            // Upload whichever mips last frame's footprints asked for
+            textureStreamer.update();
+
+            // The GIF follows simulation time, so a replay shows the same frames
+            if (animation)
+                animation->update(animationTime < 0.0 ? 0.0 : packet->state.time - animationTime);
+            animationTime = packet->state.time;
+
+            int sceneHeight = viewportHeight;
+            if (dynamicResolution) {
+                dynamicResolution->beginScene(packet->frame);
+                sceneHeight = dynamicResolution->height();
+            }
+
+            //rendering commands here
+            // Set the background color
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            shapeShader.use();
+
+            cameraUniforms.upload(packet->camera);
+
+            // Blending
+            shapeShader.setFloat("mixAmount", packet->mixAmount);
+
+            // Bindings
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture1);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, texture2);
+            if (animation) {
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, animation->texture());
+                shapeShader.setInt("animationLayer", animation->layer());
+            }
+            glBindVertexArray(VAO);
+
+            // Draw
+            for (const PacketInstance& instance : packet->instances) {
+                shapeShader.setMat4("model", instance.model);
+
+                float footprint = ScreenFootprint(packet->camera.projection(), packet->camera.view(), instance.center, instance.radius, sceneHeight);
+                textureStreamer.reportFootprint(texture1, footprint);
+                textureStreamer.reportFootprint(texture2, footprint);
+
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+
+
+            // Unbind VAO
+            glBindVertexArray(0);
+            glUseProgram(0);
+
+            if (dynamicResolution) {
+                dynamicResolution->endScene();
+                dynamicResolution->present(viewportWidth, viewportHeight);
+            }
+            renderTargets.endFrame();
+
+            // swap the buffers
+            if (replayPath)
+                gpuTimer.end();
+            for (const PacketInput& consumed : packet->inputs)
+                latency.consumed(consumed.id, consumed.time, consumed.consumed);
+            latency.submitted(glfwGetTime());
+            glfwSwapBuffers(window);
+            latency.swapped(packet->frame, glfwGetTime());
+            framesInFlight.end();
+
+            RetiredFrame retired;
+            while (framesInFlight.retire(retired))
+                latency.completed(retired.frame, retired.gpuEnd);
+            latency.update(glfwGetTime());
+
+            if (replayPath) {
+                frameTimings.frame(packet->frame, packet->steps, packet->state, glfwGetTime() - frameStart);
+                GpuTimerResult gpuTime;
+                while (gpuTimer.poll(gpuTime))
+                    frameTimings.gpu(gpuTime.tag, gpuTime.seconds);
+            }
+        }
 
-        // Unbind VAO
-        glBindVertexArray(0);
-        glUseProgram(0);
+        glFinish();
+        RetiredFrame retired;
+        while (framesInFlight.retire(retired))
+            latency.completed(retired.frame, retired.gpuEnd);
+        if (replayPath) {
+            GpuTimerResult gpuTime;
+            while (gpuTimer.poll(gpuTime, true))
+                frameTimings.gpu(gpuTime.tag, gpuTime.seconds);
+        }
+        glfwMakeContextCurrent(NULL);
+    });
+
+    // Callbacks run in here and queue input for the simulation thread. The render
+    // thread stops once the simulation thread closes the queue behind it.
+    while (!quitRequested.load()) {
+        glfwWaitEvents();
+        if (glfwWindowShouldClose(window))
+            quitRequested.store(true);
+    }
+
+    simulationThread.join();
+    renderThread.join();
+    glfwMakeContextCurrent(window);
+
+    // The GIF owns its texture, which has to go while the context is still here
+    if (animation)
+        std::cout << "GIF texture: " << gifPath << " decoded " << animation->framesDecoded() << " frames" << std::endl;
+    animation.reset();
+
+    FrameQueueStats queueStats = packets.stats();
+    std::cout << "Frame queue: " << queueStats.packets << " packets, depth " << packets.depth() << ", simulation waited "
+        << queueStats.producerWait * 1000.0 << " ms over " << queueStats.producerStalls << " stalls, render waited "
+        << queueStats.consumerWait * 1000.0 << " ms over " << queueStats.consumerStalls << " stalls" << std::endl;
+    std::cout << "Camera: " << queueStats.packets << " frames, projection rebuilt " << camera.projectionRebuilds() << " times, "
+        << cameraUniforms.uploads() << " uploads, " << cameraUniforms.skipped() << " skipped, "
+        << culledInstances << " instances culled" << std::endl;
+    pacer.writeHistogram(framePacingPath);
+    framesInFlight.report();
+    latency.report();
+    recorder.close();
+    if (replayPath)
+        frameTimings.write(timingsPath);
+    if (dynamicResolution) {
+        dynamicResolution->closeLog();
+        renderTargets.report();
+    }
 
-        // check and call events and swap the buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Replayed events were stamped in another run, so only live input has waits to report
+    if (!replayPath) {
+        InputStats inputStats = input.stats();
+        std::cout << "Input: " << inputStats.events << " events, " << inputStats.dropped << " dropped, "
+            << (inputStats.events ? inputStats.totalAge / inputStats.events * 1000.0 : 0.0) << " ms average and "
+            << inputStats.maxAge * 1000.0 << " ms longest wait to be consumed" << std::endl;
     }
 
     glfwTerminate(); 
@@ -255,22 +687,6 @@ int main()
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
-}
-
-unsigned char* loadTexture(const char* texturePath, GLenum format){
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* textureData = stbi_load(texturePath, &width, &height, &nrChannels, 0);
-     if (textureData) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, textureData);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture: " << texturePath << std::endl;
-    }
-    stbi_image_free(textureData);
-
-    std::cout << "Successfully loaded texture: " << texturePath << std::endl;
-    return textureData;
+    framebufferWidth.store(width);
+    framebufferHeight.store(height);
 }
\ No newline at end of file
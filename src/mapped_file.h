@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+// Read only view of a whole file mapped into the address space.
+// Pages are only read from disk the first time they are touched.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const { return view != nullptr; }
+	const unsigned char* data() const { return view; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* view = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+#endif
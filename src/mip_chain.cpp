@@ -0,0 +1,62 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+
+int MipChainChannels(int imageChannels) {
+	return imageChannels == 3 ? 4 : imageChannels;
+}
+
+size_t LayoutMipChain(int width, int height, int channels, MipChain& chain) {
+	chain.width = width;
+	chain.height = height;
+	chain.channels = channels;
+	chain.levels.clear();
+
+	size_t total = 0;
+	int w = width, h = height;
+	while (true) {
+		size_t size = (size_t)w * h * channels;
+		chain.levels.push_back({ w, h, total, size });
+		total += size;
+		if (w == 1 && h == 1)
+			break;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	return total;
+}
+
+void AllocateMipChain(int width, int height, int channels, MipChain& chain, int firstLevel) {
+	// Every level goes in a single allocation
+	size_t total = LayoutMipChain(width, height, channels, chain);
+	chain.pixels.reset(new unsigned char[total - chain.levels[firstLevel].offset]);
+	chain.mapped = nullptr;
+	chain.firstLevel = firstLevel;
+}
+
+void BuildMipChain(MipChain& chain) {
+	int channels = chain.channels;
+	size_t skipped = chain.levels[chain.firstLevel].offset;
+	for (size_t level = chain.firstLevel + 1; level < chain.levels.size(); level++) {
+		const MipLevel& src = chain.levels[level - 1];
+		const MipLevel& dst = chain.levels[level];
+		const unsigned char* in = chain.pixels.get() + src.offset - skipped;
+		unsigned char* out = chain.pixels.get() + dst.offset - skipped;
+
+		for (int y = 0; y < dst.height; y++) {
+			int y0 = std::min(y * 2, src.height - 1);
+			int y1 = std::min(y * 2 + 1, src.height - 1);
+			for (int x = 0; x < dst.width; x++) {
+				int x0 = std::min(x * 2, src.width - 1);
+				int x1 = std::min(x * 2 + 1, src.width - 1);
+				for (int c = 0; c < channels; c++) {
+					int sum = in[((size_t)y0 * src.width + x0) * channels + c]
+						+ in[((size_t)y0 * src.width + x1) * channels + c]
+						+ in[((size_t)y1 * src.width + x0) * channels + c]
+						+ in[((size_t)y1 * src.width + x1) * channels + c];
+					out[((size_t)y * dst.width + x) * channels + c] = (unsigned char)((sum + 2) >> 2);
+				}
+			}
+		}
+	}
+}
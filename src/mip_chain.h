@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// One level of a mip chain, level 0 is full resolution
+struct MipLevel {
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+};
+
+// Decoded texture and every mip level below it. Pixels either live in
+// memory owned by the chain or in pages of a memory mapped cache file.
+// A preview chain only has pixels from firstLevel down.
+struct MipChain {
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<MipLevel> levels;
+	std::unique_ptr<unsigned char[]> pixels;
+	const unsigned char* mapped = nullptr;
+	int firstLevel = 0;
+
+	const unsigned char* levelData(int level) const { return (mapped ? mapped : pixels.get()) + levels[level].offset - levels[firstLevel].offset; }
+	size_t totalSize() const { return levels.empty() ? 0 : levels.back().offset + levels.back().size; }
+};
+
+// Channels a chain holds for an image with the given channels. RGB is expanded to RGBA
+// while decoding, since 4-byte texels upload several times faster than 3-byte ones.
+int MipChainChannels(int imageChannels);
+
+// Fills in the level sizes and offsets, returns the bytes needed for every level
+size_t LayoutMipChain(int width, int height, int channels, MipChain& chain);
+
+// Lays the chain out and allocates its pixels from firstLevel on, left uninitialized for a decoder to write into
+void AllocateMipChain(int width, int height, int channels, MipChain& chain, int firstLevel = 0);
+
+// Box filters the first level of an allocated chain down into every other level
+void BuildMipChain(MipChain& chain);
+
+#endif
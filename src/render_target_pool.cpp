@@ -0,0 +1,130 @@
+#include "render_target_pool.h"
+
+#include <algorithm>
+#include <iostream>
+
+static size_t BytesPerPixel(GLenum format) {
+	switch (format) {
+	case 0:
+		return 0;
+	case GL_RGBA16F:
+	case GL_RGBA16:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGB8:
+	case GL_SRGB8:
+	case GL_DEPTH_COMPONENT24:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+static size_t TargetBytes(const RenderTargetKey& key) {
+	size_t pixels = (size_t)key.width * key.height * std::max(key.samples, 1);
+	return pixels * (BytesPerPixel(key.colorFormat) + BytesPerPixel(key.depthFormat));
+}
+
+RenderTargetPool::RenderTargetPool(unsigned int idleFrames) : idleFrames(std::max(idleFrames, 1u)) {}
+
+RenderTarget RenderTargetPool::acquire(const RenderTargetKey& key) {
+	for (Entry& entry : entries) {
+		if (!entry.acquired && entry.target.key == key) {
+			if (frame - entry.lastUsed > 1)
+				poolStats.reuses++;
+			entry.acquired = true;
+			entry.lastUsed = frame;
+			return entry.target;
+		}
+	}
+
+	entries.push_back({ allocate(key), frame, true });
+	return entries.back().target;
+}
+
+void RenderTargetPool::endFrame() {
+	for (Entry& entry : entries)
+		entry.acquired = false;
+
+	auto idle = std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+		if (frame - entry.lastUsed < idleFrames)
+			return false;
+		release(entry.target);
+		return true;
+	});
+	entries.erase(idle, entries.end());
+	frame++;
+}
+
+RenderTarget RenderTargetPool::allocate(const RenderTargetKey& key) {
+	RenderTarget target = { key, 0, 0, 0 };
+	glGenFramebuffers(1, &target.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+
+	// Only the internal format matters without data, so any normalized or float format
+	// takes the same transfer format
+	glGenTextures(1, &target.color);
+	if (key.samples > 0) {
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.color);
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, key.samples, key.colorFormat, key.width, key.height, GL_TRUE);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, target.color, 0);
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, target.color);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, key.colorFormat, key.width, key.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+	}
+
+	if (key.depthFormat) {
+		GLenum attachment = key.depthFormat == GL_DEPTH24_STENCIL8 || key.depthFormat == GL_DEPTH32F_STENCIL8
+			? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glGenRenderbuffers(1, &target.depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+		if (key.samples > 0)
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, key.samples, key.depthFormat, key.width, key.height);
+		else
+			glRenderbufferStorage(GL_RENDERBUFFER, key.depthFormat, key.width, key.height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, target.depth);
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Render target pool: incomplete framebuffer (" << key.width << "x" << key.height << ", " << key.samples << " samples)" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	poolStats.allocations++;
+	poolStats.bytes += TargetBytes(key);
+	poolStats.peakBytes = std::max(poolStats.peakBytes, poolStats.bytes);
+	return target;
+}
+
+void RenderTargetPool::release(const RenderTarget& target) {
+	// GL holds on to the storage until commands already submitted that use it are done
+	glDeleteFramebuffers(1, &target.framebuffer);
+	glDeleteTextures(1, &target.color);
+	if (target.depth)
+		glDeleteRenderbuffers(1, &target.depth);
+
+	poolStats.releases++;
+	poolStats.bytes -= TargetBytes(target.key);
+}
+
+void RenderTargetPool::report() const {
+	std::cout << "Render target pool: " << poolStats.allocations << " allocated, " << poolStats.releases << " released, "
+		<< poolStats.reuses << " reused, " << entries.size() << " live, "
+		<< poolStats.peakBytes / (1024.0 * 1024.0) << " MB at most" << std::endl;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// What a target is looked up by. Color formats are sized normalized or float ones,
+// depthFormat 0 leaves the target without depth and samples 0 makes it single sampled.
+struct RenderTargetKey {
+	int width;
+	int height;
+	GLenum colorFormat;
+	GLenum depthFormat;
+	int samples;
+
+	bool operator==(const RenderTargetKey& other) const {
+		return width == other.width && height == other.height && colorFormat == other.colorFormat
+			&& depthFormat == other.depthFormat && samples == other.samples;
+	}
+};
+
+struct RenderTarget {
+	RenderTargetKey key;
+	GLuint framebuffer;
+	GLuint color;         // GL_TEXTURE_2D, or GL_TEXTURE_2D_MULTISAMPLE with samples
+	GLuint depth;         // renderbuffer, 0 without depthFormat
+};
+
+struct RenderTargetPoolStats {
+	unsigned int allocations = 0;
+	unsigned int releases = 0;
+	unsigned int reuses = 0;     // acquires of a target that had been idle for a frame or more
+	size_t bytes = 0;            // estimated GPU memory of the live targets
+	size_t peakBytes = 0;
+};
+
+// Offscreen targets shared by whatever draws offscreen. A target is created the first
+// time a key is asked for, handed out to one caller per frame, and deleted once no
+// frame has asked for it in a while, so a size that was only passed through while the
+// window was being resized doesn't stay allocated. Targets still in the pool go away
+// with the context.
+class RenderTargetPool {
+public:
+	RenderTargetPool(unsigned int idleFrames = 8);
+
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	// A target matching key that nothing else has acquired this frame
+	RenderTarget acquire(const RenderTargetKey& key);
+
+	// Hands every target back and deletes those idle for idleFrames frames
+	void endFrame();
+
+	size_t size() const { return entries.size(); }
+	RenderTargetPoolStats stats() const { return poolStats; }
+	void report() const;
+
+private:
+	struct Entry {
+		RenderTarget target;
+		unsigned long long lastUsed;
+		bool acquired;
+	};
+
+	RenderTarget allocate(const RenderTargetKey& key);
+	void release(const RenderTarget& target);
+
+	unsigned int idleFrames;
+	unsigned long long frame = 0;
+	std::vector<Entry> entries;
+	RenderTargetPoolStats poolStats;
+};
+
+#endif
@@ -6,9 +6,12 @@ out vec4 FragColor;
 
 uniform sampler2D texture1;
 uniform sampler2D texture2;
+uniform sampler2DArray animation;
+uniform int animationLayer;    // -1 without a GIF, which leaves texture2 on top
 
 uniform float mixAmount;
 
 void main() {
-	 FragColor = mix(texture(texture1, texCoord), texture(texture2, vec2(texCoord.x, texCoord.y)), mixAmount);
+	vec4 overlay = animationLayer < 0 ? texture(texture2, texCoord) : texture(animation, vec3(texCoord, animationLayer));
+	 FragColor = mix(texture(texture1, texCoord), overlay, mixAmount);
 }
\ No newline at end of file
@@ -106,6 +106,9 @@ public:
 	void setFloat(const std::string& name, float value) const {
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 	}
+	void setVec2(const std::string& name, float x, float y) const {
+		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	}
 	void setMat4(const std::string& name, glm::mat4 value) const {
 		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
 	}
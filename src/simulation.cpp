@@ -0,0 +1,22 @@
+#include "simulation.h"
+
+#include <cmath>
+
+// Degrees per second, what glfwGetTime() * 25 drew before
+static const float SPIN_SPEED = 25.0f;
+
+void Simulate(SimulationState& state, double seconds) {
+	state.time += seconds;
+	state.spinAngle = (float)std::fmod(state.time * SPIN_SPEED, 360.0);
+}
+
+SimulationState Interpolate(const SimulationState& previous, const SimulationState& current, float alpha) {
+	// Angles that wrapped during the step keep going the same way
+	float spinTo = current.spinAngle < previous.spinAngle ? current.spinAngle + 360.0f : current.spinAngle;
+
+	SimulationState state;
+	state.time = previous.time + (current.time - previous.time) * alpha;
+	state.spinAngle = previous.spinAngle + (spinTo - previous.spinAngle) * alpha;
+	state.fov = previous.fov + (current.fov - previous.fov) * alpha;
+	return state;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// Everything that changes over time in the scene, advanced only in fixed steps
+struct SimulationState {
+	double time = 0.0;        // simulated seconds
+	float spinAngle = 0.0f;   // degrees, for the cubes that spin, kept in [0, 360)
+	float fov = 45.0f;
+};
+
+// Moves the state forward by one step of seconds
+void Simulate(SimulationState& state, double seconds);
+
+// State alpha of the way from previous to current, for drawing between steps
+SimulationState Interpolate(const SimulationState& previous, const SimulationState& current, float alpha);
+
+#endif
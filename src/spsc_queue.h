@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed size ring passing values from one producer thread to one consumer thread
+// without locks. Each side only writes its own index, so a push never waits on a pop.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() = default;
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer side, false when the queue is full
+	bool push(const T& value) {
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		if (tail - headIndex.load(std::memory_order_acquire) == Capacity)
+			return false;
+		slots[tail & (Capacity - 1)] = value;
+		tailIndex.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, the oldest value or nullptr when empty. It stays valid until pop().
+	const T* front() const {
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailIndex.load(std::memory_order_acquire))
+			return nullptr;
+		return &slots[head & (Capacity - 1)];
+	}
+
+	void pop() {
+		headIndex.store(headIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	// Indices only grow and wrap through the mask, on separate lines so the two
+	// threads don't bounce a cache line between them
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+	alignas(64) T slots[Capacity];
+};
+
+#endif
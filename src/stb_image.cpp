@@ -1,2 +1,8 @@
+#include "decode_arena.h"
+
+// Allocations come out of the calling thread's decode arena while a scope is open
+#define STBI_MALLOC(size)                          DecodeArenaMalloc(size)
+#define STBI_REALLOC_SIZED(pointer, oldSize, newSize) DecodeArenaRealloc(pointer, oldSize, newSize)
+#define STBI_FREE(pointer)                         DecodeArenaFree(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
\ No newline at end of file
@@ -242,6 +242,18 @@ RECENT REVISION HISTORY:
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// Where SSE2 is used, the JPEG IDCT, YCbCr conversion and 2x2 upsampling
+// kernels also have AVX2 versions, picked with a run-time CPUID test so the
+// SSE2 loops stay as the fall-back. They produce bit-identical output to the
+// generic C versions. Define STBI_NO_AVX2 to leave them out.
+//
+// PNG scanline unfiltering uses SSE2 for 3, 4, 6 and 8 byte pixels, and the
+// pass that adds alpha and byte-swaps 16-bit samples uses SSE2 or AVX2.
+// Converting to req_comp does the gray and gray+alpha expansions with SSE2
+// and RGB<->RGBA with AVX2, for 8 and 16-bit samples; the rest stays C.
+// Radiance RGBE pixels are turned into half floats or R11G11B10 with SSE2,
+// bit-identical to the C path, which rounds to nearest even.
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -400,6 +412,44 @@ extern "C" {
 
 #ifndef STBI_NO_GIF
     STBIDEF stbi_uc* stbi_load_gif_from_memory(stbi_uc const* buffer, int len, int** delays, int* x, int* y, int* z, int* comp, int req_comp);
+
+    // animated GIFs one frame at a time, instead of every frame in one allocation. the
+    // stream keeps the current frame and the two before it (for "restore to previous"
+    // disposal), whatever the length of the animation. buffer must outlive the stream.
+    // stbi_gif_stream_next returns the next frame as 4 channels, top row first, valid
+    // until the following call, and NULL after the last frame or on corrupt data.
+    // stbi_gif_stream_rewind starts over from the first frame, for looping
+    typedef struct stbi_gif_stream stbi_gif_stream;
+
+    STBIDEF stbi_gif_stream* stbi_gif_stream_open_memory(stbi_uc const* buffer, int len, int* x, int* y);
+    STBIDEF stbi_uc* stbi_gif_stream_next(stbi_gif_stream* gif, int* delay_ms);
+    STBIDEF void             stbi_gif_stream_rewind(stbi_gif_stream* gif);
+    STBIDEF void             stbi_gif_stream_close(stbi_gif_stream* gif);
+#endif
+
+    // multithreaded loading. 'run' must call task(task_data, i) for every i in [0, count)
+    // and only return once all of them have finished; the calls may happen in parallel on
+    // any threads. baseline JPEGs with restart markers decode their restart intervals in
+    // parallel, and JPEG upsampling and color conversion are split into bands of rows.
+    // everything else loads exactly as with the functions above.
+    typedef void (*stbi_parallel_for)(void* user, int count, void (*task)(void* task_data, int index), void* task_data);
+
+    STBIDEF stbi_uc* stbi_load_from_memory_mt(stbi_uc const* buffer, int len, int* x, int* y, int* channels_in_file, int desired_channels, stbi_parallel_for run, void* user);
+#ifndef STBI_NO_STDIO
+    // reads the whole file up front, the parallel JPEG path needs random access to it
+    STBIDEF stbi_uc* stbi_load_mt(char const* filename, int* x, int* y, int* channels_in_file, int desired_channels, stbi_parallel_for run, void* user);
+#endif
+
+    // decode into caller memory such as a mapped pixel buffer instead of a new allocation.
+    // rows of x * desired_channels bytes are written dest_stride bytes apart, bottom row first
+    // if flip_vertically is nonzero; this replaces stbi_set_flip_vertically_on_load for the
+    // call, so loader threads don't share any state. desired_channels can't be 0. fails if
+    // the rows don't fit in dest_size bytes. JPEGs are converted straight into dest, other
+    // formats with a single copy. 'run' is optional and works as for stbi_load_mt. returns 1
+    // on success
+    STBIDEF int stbi_load_from_memory_into(stbi_uc const* buffer, int len, stbi_uc* dest, size_t dest_size, int dest_stride, int* x, int* y, int* channels_in_file, int desired_channels, int flip_vertically, stbi_parallel_for run, void* user);
+#ifndef STBI_NO_STDIO
+    STBIDEF int stbi_load_into(char const* filename, stbi_uc* dest, size_t dest_size, int dest_stride, int* x, int* y, int* channels_in_file, int desired_channels, int flip_vertically, stbi_parallel_for run, void* user);
 #endif
 
 #ifdef STBI_WINDOWS_UTF8
@@ -436,6 +486,23 @@ extern "C" {
 #ifndef STBI_NO_HDR
     STBIDEF void   stbi_hdr_to_ldr_gamma(float gamma);
     STBIDEF void   stbi_hdr_to_ldr_scale(float scale);
+
+    // Radiance .hdr files decoded straight to a texture format, without the 32-bit float
+    // image in between. STBI_hdr_rgba16f is 4 half floats per pixel with alpha 1 (GL_RGBA16F
+    // from GL_HALF_FLOAT), STBI_hdr_r11g11b10f one 32-bit word per pixel (GL_R11F_G11F_B10F
+    // from GL_UNSIGNED_INT_10F_11F_11F_REV). values past the format's range are clamped to
+    // its largest finite one. rows are bottom up if flip_vertically is nonzero, whatever
+    // stbi_set_flip_vertically_on_load says. free the result with stbi_image_free
+    enum
+    {
+        STBI_hdr_rgba16f = 1,
+        STBI_hdr_r11g11b10f = 2
+    };
+
+    STBIDEF void* stbi_load_hdr_packed_from_memory(stbi_uc const* buffer, int len, int* x, int* y, int format, int flip_vertically);
+#ifndef STBI_NO_STDIO
+    STBIDEF void* stbi_load_hdr_packed(char const* filename, int* x, int* y, int format, int flip_vertically);
+#endif
 #endif // STBI_NO_HDR
 
 #ifndef STBI_NO_LINEAR
@@ -483,7 +550,9 @@ extern "C" {
     // or just pass them through "as-is"
     STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 
-    // flip the image vertically, so the first pixel in the output array is the bottom left
+    // flip the image vertically, so the first pixel in the output array is the bottom left.
+    // JPEG, PNG and TGA write their rows bottom up as they decode, other formats are flipped
+    // after loading
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
     // as above, but only applies to images loaded on the thread that calls the function
@@ -491,6 +560,14 @@ extern "C" {
     // calling it will fail to link if your compiler doesn't
     STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+    // progressive JPEGs loaded on this thread call back as soon as the first scans have
+    // brought in the DC coefficients of every component, long before the image is done.
+    // the preview is the image at 1/8 scale, (x+7)/8 by (y+7)/8 pixels of desired_channels
+    // (the file's if 0), flipped if the load is, and only valid during the call. pass NULL
+    // to stop. like the function above, this needs thread-local variables
+    typedef void (*stbi_preview_callback)(void* user, stbi_uc const* pixels, int x, int y, int channels);
+    STBIDEF void stbi_set_preview_callback_thread(stbi_preview_callback callback, void* user);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char* stbi_zlib_decode_malloc_guesssize(const char* buffer, int len, int initial_size, int* outlen);
@@ -610,12 +687,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -717,7 +796,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     int info3 = stbi__cpuid3();
@@ -728,7 +807,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
     // If we're even attempting to compile this on GCC/Clang, that means
@@ -741,6 +820,75 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 is never assumed, it's only used after checking CPUID and that the OS
+// saves the YMM registers. The kernels are compiled with a function target
+// attribute on GCC/Clang so the rest of the file doesn't need -mavx2.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+
+static int stbi__avx2_detect(void)
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    // OSXSAVE and AVX
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0;
+    if ((_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] >> 5) & 1;
+}
+#else
+#include <cpuid.h>
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+
+static int stbi__avx2_detect(void)
+{
+    unsigned int a, b, c, d, xcr0_lo, xcr0_hi;
+    if (__get_cpuid_max(0, 0) < 7) return 0;
+    __cpuid(1, a, b, c, d);
+    // OSXSAVE and AVX
+    if ((c & (1u << 27)) == 0 || (c & (1u << 28)) == 0) return 0;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b >> 5) & 1;
+}
+#endif
+
+// CPUID can trap to the hypervisor and stbi__setup_jpeg runs on every
+// stbi__jpeg_test, so detect once. Decode threads get here concurrently, so
+// the cached value is read and written atomically; racing threads may each
+// detect, but they all store the same value.
+#ifdef _MSC_VER
+static int stbi__avx2_available(void)
+{
+    static volatile long available = -1;
+    long value = _InterlockedCompareExchange(&available, -1, -1);
+    if (value < 0) {
+        value = stbi__avx2_detect();
+        _InterlockedExchange(&available, value);
+    }
+    return (int) value;
+}
+#else
+static int stbi__avx2_available(void)
+{
+    static int available = -1;
+    int value = __atomic_load_n(&available, __ATOMIC_ACQUIRE);
+    if (value < 0) {
+        value = stbi__avx2_detect();
+        __atomic_store_n(&available, value, __ATOMIC_RELEASE);
+    }
+    return value;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -781,6 +929,15 @@ typedef struct
 
     stbi_uc* img_buffer, * img_buffer_end;
     stbi_uc* img_buffer_original, * img_buffer_original_end;
+
+    stbi_parallel_for parallel_for; // set by the _mt and _into entry points
+    void* parallel_user;
+
+    stbi_uc* dest;       // set by the _into entry points, decoders may write rows here directly
+    size_t dest_size;
+    int dest_stride;
+
+    int flip;            // rows are wanted bottom up, loaders that write them so set ri->flipped
 } stbi__context;
 
 
@@ -794,6 +951,10 @@ static void stbi__start_mem(stbi__context* s, stbi_uc const* buffer, int len)
     s->callback_already_read = 0;
     s->img_buffer = s->img_buffer_original = (stbi_uc*)buffer;
     s->img_buffer_end = s->img_buffer_original_end = (stbi_uc*)buffer + len;
+    s->parallel_for = NULL;
+    s->parallel_user = NULL;
+    s->dest = NULL;
+    s->flip = 0;
 }
 
 // initialize a callback-based context
@@ -805,6 +966,10 @@ static void stbi__start_callbacks(stbi__context* s, stbi_io_callbacks* c, void*
     s->read_from_callbacks = 1;
     s->callback_already_read = 0;
     s->img_buffer = s->img_buffer_original = s->buffer_start;
+    s->parallel_for = NULL;
+    s->parallel_user = NULL;
+    s->dest = NULL;
+    s->flip = 0;
     stbi__refill_buffer(s);
     s->img_buffer_original_end = s->img_buffer_end;
 }
@@ -867,6 +1032,7 @@ typedef struct
     int bits_per_channel;
     int num_channels;
     int channel_order;
+    int flipped; // rows are already bottom up
 } stbi__result_info;
 
 #ifndef STBI_NO_JPEG
@@ -904,6 +1070,7 @@ static int      stbi__psd_is16(stbi__context* s);
 #ifndef STBI_NO_HDR
 static int      stbi__hdr_test(stbi__context* s);
 static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri);
+static void* stbi__hdr_load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, int format, int flip);
 static int      stbi__hdr_info(stbi__context* s, int* x, int* y, int* comp);
 #endif
 
@@ -1066,6 +1233,8 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 
 #ifndef STBI_THREAD_LOCAL
 #define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
+#define stbi__preview_callback         ((stbi_preview_callback)NULL)
+#define stbi__preview_user             NULL
 #else
 static STBI_THREAD_LOCAL int stbi__vertically_flip_on_load_local, stbi__vertically_flip_on_load_set;
 
@@ -1078,6 +1247,15 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
 #define stbi__vertically_flip_on_load  (stbi__vertically_flip_on_load_set       \
                                          ? stbi__vertically_flip_on_load_local  \
                                          : stbi__vertically_flip_on_load_global)
+
+static STBI_THREAD_LOCAL stbi_preview_callback stbi__preview_callback;
+static STBI_THREAD_LOCAL void* stbi__preview_user;
+
+STBIDEF void stbi_set_preview_callback_thread(stbi_preview_callback callback, void* user)
+{
+    stbi__preview_callback = callback;
+    stbi__preview_user = user;
+}
 #endif // STBI_THREAD_LOCAL
 
 static void* stbi__load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri, int bpc)
@@ -1200,7 +1378,10 @@ static void stbi__vertical_flip_slices(void* image, int w, int h, int z, int byt
 static unsigned char* stbi__load_and_postprocess_8bit(stbi__context* s, int* x, int* y, int* comp, int req_comp)
 {
     stbi__result_info ri;
-    void* result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+    void* result;
+
+    s->flip = stbi__vertically_flip_on_load;
+    result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
 
     if (result == NULL)
         return NULL;
@@ -1215,7 +1396,7 @@ static unsigned char* stbi__load_and_postprocess_8bit(stbi__context* s, int* x,
 
     // @TODO: move stbi__convert_format to here
 
-    if (stbi__vertically_flip_on_load) {
+    if (s->flip && !ri.flipped) {
         int channels = req_comp ? req_comp : *comp;
         stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
     }
@@ -1226,7 +1407,10 @@ static unsigned char* stbi__load_and_postprocess_8bit(stbi__context* s, int* x,
 static stbi__uint16* stbi__load_and_postprocess_16bit(stbi__context* s, int* x, int* y, int* comp, int req_comp)
 {
     stbi__result_info ri;
-    void* result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
+    void* result;
+
+    s->flip = stbi__vertically_flip_on_load;
+    result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
 
     if (result == NULL)
         return NULL;
@@ -1242,7 +1426,7 @@ static stbi__uint16* stbi__load_and_postprocess_16bit(stbi__context* s, int* x,
     // @TODO: move stbi__convert_format16 to here
     // @TODO: special case RGB-to-Y (and RGBA-to-YA) for 8-bit-to-16-bit case to keep more precision
 
-    if (stbi__vertically_flip_on_load) {
+    if (s->flip && !ri.flipped) {
         int channels = req_comp ? req_comp : *comp;
         stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
     }
@@ -1380,6 +1564,108 @@ STBIDEF stbi_uc* stbi_load_from_callbacks(stbi_io_callbacks const* clbk, void* u
     return stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
 }
 
+STBIDEF stbi_uc* stbi_load_from_memory_mt(stbi_uc const* buffer, int len, int* x, int* y, int* comp, int req_comp, stbi_parallel_for run, void* user)
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    s.parallel_for = run;
+    s.parallel_user = user;
+    return stbi__load_and_postprocess_8bit(&s, x, y, comp, req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+static stbi_uc* stbi__read_file(char const* filename, int* len)
+{
+    FILE* f = stbi__fopen(filename, "rb");
+    stbi_uc* buffer;
+    long size;
+    if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0 || size > INT_MAX) { fclose(f); return stbi__errpuc("can't ftell", "Unable to read file"); }
+    buffer = (stbi_uc*)stbi__malloc(size ? size : 1);
+    if (!buffer) { fclose(f); return stbi__errpuc("outofmem", "Out of memory"); }
+    if (fread(buffer, 1, size, f) != (size_t)size) { fclose(f); STBI_FREE(buffer); return stbi__errpuc("can't fread", "Unable to read file"); }
+    fclose(f);
+    *len = (int)size;
+    return buffer;
+}
+
+STBIDEF stbi_uc* stbi_load_mt(char const* filename, int* x, int* y, int* comp, int req_comp, stbi_parallel_for run, void* user)
+{
+    int len;
+    stbi_uc* result, * buffer = stbi__read_file(filename, &len);
+    if (!buffer) return NULL;
+    result = stbi_load_from_memory_mt(buffer, len, x, y, comp, req_comp, run, user);
+    STBI_FREE(buffer);
+    return result;
+}
+#endif
+
+// returns 1 if h rows of row_bytes fit the caller's memory
+static int stbi__dest_fits(stbi__context* s, int row_bytes, int h)
+{
+    if (s->dest_stride < row_bytes) return 0;
+    return (size_t)s->dest_stride * (h - 1) + row_bytes <= s->dest_size;
+}
+
+static int stbi__load_into(stbi__context* s, stbi_uc* dest, size_t dest_size, int dest_stride, int* x, int* y, int* comp, int req_comp, int flip)
+{
+    stbi__result_info ri;
+    void* result;
+    int i, j, row_bytes;
+
+    if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+    s->dest = dest;
+    s->dest_size = dest_size;
+    s->dest_stride = dest_stride;
+    s->flip = flip;
+
+    result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+    if (result == NULL) return 0;
+    if (result == dest) return 1; // the decoder wrote the rows itself
+
+    row_bytes = *x * req_comp;
+    if (!stbi__dest_fits(s, row_bytes, *y)) { STBI_FREE(result); return stbi__err("dest too small", "Destination too small"); }
+
+    // one pass that flips, unless the loader did, and narrows 16 bit samples while copying
+    for (j = 0; j < *y; ++j) {
+        stbi_uc* row = dest + (ptrdiff_t)dest_stride * (s->flip && !ri.flipped ? *y - 1 - j : j);
+        if (ri.bits_per_channel == 16) {
+            stbi__uint16* in = (stbi__uint16*)result + (size_t)row_bytes * j;
+            for (i = 0; i < row_bytes; ++i)
+                row[i] = (stbi_uc)(in[i] >> 8);
+        }
+        else {
+            memcpy(row, (stbi_uc*)result + (size_t)row_bytes * j, row_bytes);
+        }
+    }
+    STBI_FREE(result);
+    return 1;
+}
+
+STBIDEF int stbi_load_from_memory_into(stbi_uc const* buffer, int len, stbi_uc* dest, size_t dest_size, int dest_stride, int* x, int* y, int* comp, int req_comp, int flip_vertically, stbi_parallel_for run, void* user)
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    s.parallel_for = run;
+    s.parallel_user = user;
+    return stbi__load_into(&s, dest, dest_size, dest_stride, x, y, comp, req_comp, flip_vertically);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into(char const* filename, stbi_uc* dest, size_t dest_size, int dest_stride, int* x, int* y, int* comp, int req_comp, int flip_vertically, stbi_parallel_for run, void* user)
+{
+    int len, result;
+    stbi_uc* buffer = stbi__read_file(filename, &len);
+    if (!buffer) return 0;
+    result = stbi_load_from_memory_into(buffer, len, dest, dest_size, dest_stride, x, y, comp, req_comp, flip_vertically, run, user);
+    STBI_FREE(buffer);
+    return result;
+}
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc* stbi_load_gif_from_memory(stbi_uc const* buffer, int len, int** delays, int* x, int* y, int* z, int* comp, int req_comp)
 {
@@ -1450,6 +1736,36 @@ STBIDEF float* stbi_loadf_from_file(FILE* f, int* x, int* y, int* comp, int req_
 
 #endif // !STBI_NO_LINEAR
 
+#ifndef STBI_NO_HDR
+static void* stbi__load_hdr_packed(stbi__context* s, int* x, int* y, int format, int flip_vertically)
+{
+    if (format != STBI_hdr_rgba16f && format != STBI_hdr_r11g11b10f) return stbi__errpuc("bad format", "Internal error");
+    if (!stbi__hdr_test(s)) return stbi__errpuc("not HDR", "Image not of Radiance HDR type");
+    return stbi__hdr_load_main(s, x, y, NULL, 3, format, flip_vertically);
+}
+
+STBIDEF void* stbi_load_hdr_packed_from_memory(stbi_uc const* buffer, int len, int* x, int* y, int format, int flip_vertically)
+{
+    stbi__context s;
+    stbi__start_mem(&s, buffer, len);
+    return stbi__load_hdr_packed(&s, x, y, format, flip_vertically);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF void* stbi_load_hdr_packed(char const* filename, int* x, int* y, int format, int flip_vertically)
+{
+    stbi__context s;
+    void* result;
+    FILE* f = stbi__fopen(filename, "rb");
+    if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+    stbi__start_file(&s, f);
+    result = stbi__load_hdr_packed(&s, x, y, format, flip_vertically);
+    fclose(f);
+    return result;
+}
+#endif // !STBI_NO_STDIO
+#endif // !STBI_NO_HDR
+
 // these is-hdr-or-not is defined independent of whether STBI_NO_LINEAR is
 // defined, for API simplicity; if STBI_NO_LINEAR is defined, it always
 // reports false!
@@ -1693,9 +2009,172 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
-static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int req_comp, unsigned int x, unsigned int y)
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
+#define STBI__CONVERT_SIMD
+// the common expansions, mostly towards 4 channels so rows are 4-byte aligned for upload.
+// each returns how many pixels it wrote, the rest of the row goes through the generic loop
+static int stbi__convert_row_sse2(stbi_uc* dest, const stbi_uc* src, int x, int img_n, int req_comp)
 {
-    int i, j;
+    __m128i ff = _mm_set1_epi8(-1);
+    int i = 0;
+    switch (img_n * 8 + req_comp) {
+    case 1 * 8 + 2:
+        for (; i + 16 <= x; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            _mm_storeu_si128((__m128i*) (dest + i * 2), _mm_unpacklo_epi8(v, ff));
+            _mm_storeu_si128((__m128i*) (dest + i * 2 + 16), _mm_unpackhi_epi8(v, ff));
+        }
+        break;
+    case 1 * 8 + 4:
+        for (; i + 16 <= x; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i gg = _mm_unpacklo_epi8(v, v), ga = _mm_unpacklo_epi8(v, ff);
+            _mm_storeu_si128((__m128i*) (dest + i * 4), _mm_unpacklo_epi16(gg, ga));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 16), _mm_unpackhi_epi16(gg, ga));
+            gg = _mm_unpackhi_epi8(v, v);
+            ga = _mm_unpackhi_epi8(v, ff);
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 32), _mm_unpacklo_epi16(gg, ga));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 48), _mm_unpackhi_epi16(gg, ga));
+        }
+        break;
+    case 2 * 8 + 4:
+        for (; i + 8 <= x; i += 8) {
+            // each 16-bit lane is a gray, alpha pair
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 2));
+            __m128i g = _mm_and_si128(v, _mm_set1_epi16(0xff));
+            __m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+            _mm_storeu_si128((__m128i*) (dest + i * 4), _mm_unpacklo_epi16(gg, v));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 16), _mm_unpackhi_epi16(gg, v));
+        }
+        break;
+    }
+    return i;
+}
+
+static int stbi__convert_row16_sse2(stbi__uint16* dest, const stbi__uint16* src, int x, int img_n, int req_comp)
+{
+    __m128i ffff = _mm_set1_epi16(-1);
+    int i = 0;
+    switch (img_n * 8 + req_comp) {
+    case 1 * 8 + 2:
+        for (; i + 8 <= x; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            _mm_storeu_si128((__m128i*) (dest + i * 2), _mm_unpacklo_epi16(v, ffff));
+            _mm_storeu_si128((__m128i*) (dest + i * 2 + 8), _mm_unpackhi_epi16(v, ffff));
+        }
+        break;
+    case 1 * 8 + 4:
+        for (; i + 8 <= x; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i gg = _mm_unpacklo_epi16(v, v), ga = _mm_unpacklo_epi16(v, ffff);
+            _mm_storeu_si128((__m128i*) (dest + i * 4), _mm_unpacklo_epi32(gg, ga));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 8), _mm_unpackhi_epi32(gg, ga));
+            gg = _mm_unpackhi_epi16(v, v);
+            ga = _mm_unpackhi_epi16(v, ffff);
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 16), _mm_unpacklo_epi32(gg, ga));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 24), _mm_unpackhi_epi32(gg, ga));
+        }
+        break;
+    case 2 * 8 + 4:
+        for (; i + 4 <= x; i += 4) {
+            // each 32-bit lane is a gray, alpha pair
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 2));
+            __m128i gg = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+            _mm_storeu_si128((__m128i*) (dest + i * 4), _mm_unpacklo_epi32(gg, v));
+            _mm_storeu_si128((__m128i*) (dest + i * 4 + 8), _mm_unpackhi_epi32(gg, v));
+        }
+        break;
+    }
+    return i;
+}
+#endif // STBI_SSE2
+
+#if defined(STBI__CONVERT_SIMD) && defined(STBI_AVX2)
+// RGB to RGBA and back need byte shuffles. Each 128-bit lane handles 4 pixels
+// and reads or writes 16 bytes of which it uses 12, hence the pixels kept back
+// from the end of the row.
+STBI__AVX2_TARGET static int stbi__convert_row_avx2(stbi_uc* dest, const stbi_uc* src, int x, int img_n, int req_comp)
+{
+    int i = 0;
+    if (img_n == 3 && req_comp == 4) {
+        __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+        for (; i + 10 <= x; i += 8) {
+            __m128i lo = _mm_loadu_si128((const __m128i*) (src + i * 3));
+            __m128i hi = _mm_loadu_si128((const __m128i*) (src + i * 3 + 12));
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*) (dest + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, spread), alpha));
+        }
+    }
+    else if (img_n == 4 && req_comp == 3) {
+        __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (; i + 10 <= x; i += 8) {
+            __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*) (src + i * 4)), pack);
+            // the second store overwrites the 4 spare bytes of the first
+            _mm_storeu_si128((__m128i*) (dest + i * 3), _mm256_castsi256_si128(v));
+            _mm_storeu_si128((__m128i*) (dest + i * 3 + 12), _mm256_extracti128_si256(v, 1));
+        }
+    }
+    return i;
+}
+
+STBI__AVX2_TARGET static int stbi__convert_row16_avx2(stbi__uint16* dest, const stbi__uint16* src, int x, int img_n, int req_comp)
+{
+    int i = 0;
+    if (img_n == 3 && req_comp == 4) {
+        __m256i spread = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1,
+            0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+        __m256i alpha = _mm256_set1_epi64x((long long)0xffff000000000000ull);
+        for (; i + 5 <= x; i += 4) {
+            __m128i lo = _mm_loadu_si128((const __m128i*) (src + i * 3));
+            __m128i hi = _mm_loadu_si128((const __m128i*) (src + i * 3 + 6));
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*) (dest + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, spread), alpha));
+        }
+    }
+    return i;
+}
+#endif // STBI_AVX2
+
+// simd is 0 for plain C, 1 for SSE2 and 2 when AVX2 can be used as well
+static int stbi__convert_simd_level(void)
+{
+    int simd = 0;
+#ifdef STBI__CONVERT_SIMD
+    if (stbi__sse2_available()) simd = 1;
+#ifdef STBI_AVX2
+    if (simd && stbi__avx2_available()) simd = 2;
+#endif
+#endif
+    return simd;
+}
+
+static int stbi__convert_row(stbi_uc* dest, const stbi_uc* src, int x, int img_n, int req_comp, int simd)
+{
+    int i = 0;
+#if defined(STBI__CONVERT_SIMD) && defined(STBI_AVX2)
+    if (simd == 2)
+        i = stbi__convert_row_avx2(dest, src, x, img_n, req_comp);
+#endif
+#ifdef STBI__CONVERT_SIMD
+    if (simd && i == 0)
+        i = stbi__convert_row_sse2(dest, src, x, img_n, req_comp);
+#endif
+    STBI_NOTUSED(dest);
+    STBI_NOTUSED(src);
+    STBI_NOTUSED(x);
+    STBI_NOTUSED(img_n);
+    STBI_NOTUSED(req_comp);
+    STBI_NOTUSED(simd);
+    return i;
+}
+
+// simd is the widest kernel level to use, 0 for the per-pixel loops alone
+static unsigned char* stbi__convert_format_level(unsigned char* data, int img_n, int req_comp, unsigned int x, unsigned int y, int simd)
+{
+    int i, j, done;
     unsigned char* good;
 
     if (req_comp == img_n) return data;
@@ -1711,8 +2190,13 @@ static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int r
         unsigned char* src = data + j * x * img_n;
         unsigned char* dest = good + j * x * req_comp;
 
+        // the vectorized part of the row, if any, then the rest pixel by pixel
+        done = stbi__convert_row(dest, src, (int)x, img_n, req_comp, simd);
+        src += done * img_n;
+        dest += done * req_comp;
+
 #define STBI__COMBO(a,b)  ((a)*8+(b))
-#define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+#define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1-done; i >= 0; --i, src += a, dest += b)
         // convert source image with img_n components to one with req_comp components;
         // avoid switch per pixel, so use switch per scanline and massive macros
         switch (STBI__COMBO(img_n, req_comp)) {
@@ -1736,6 +2220,11 @@ static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int r
     STBI_FREE(data);
     return good;
 }
+
+static unsigned char* stbi__convert_format(unsigned char* data, int img_n, int req_comp, unsigned int x, unsigned int y)
+{
+    return stbi__convert_format_level(data, img_n, req_comp, x, y, stbi__convert_simd_level());
+}
 #endif
 
 #if defined(STBI_NO_PNG) && defined(STBI_NO_PSD)
@@ -1750,9 +2239,29 @@ static stbi__uint16 stbi__compute_y_16(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_PSD)
 // nothing
 #else
-static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int req_comp, unsigned int x, unsigned int y)
+static int stbi__convert_row16(stbi__uint16* dest, const stbi__uint16* src, int x, int img_n, int req_comp, int simd)
 {
-    int i, j;
+    int i = 0;
+#if defined(STBI__CONVERT_SIMD) && defined(STBI_AVX2)
+    if (simd == 2)
+        i = stbi__convert_row16_avx2(dest, src, x, img_n, req_comp);
+#endif
+#ifdef STBI__CONVERT_SIMD
+    if (simd && i == 0)
+        i = stbi__convert_row16_sse2(dest, src, x, img_n, req_comp);
+#endif
+    STBI_NOTUSED(dest);
+    STBI_NOTUSED(src);
+    STBI_NOTUSED(x);
+    STBI_NOTUSED(img_n);
+    STBI_NOTUSED(req_comp);
+    STBI_NOTUSED(simd);
+    return i;
+}
+
+static stbi__uint16* stbi__convert_format16_level(stbi__uint16* data, int img_n, int req_comp, unsigned int x, unsigned int y, int simd)
+{
+    int i, j, done;
     stbi__uint16* good;
 
     if (req_comp == img_n) return data;
@@ -1768,8 +2277,12 @@ static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int r
         stbi__uint16* src = data + j * x * img_n;
         stbi__uint16* dest = good + j * x * req_comp;
 
+        done = stbi__convert_row16(dest, src, (int)x, img_n, req_comp, simd);
+        src += done * img_n;
+        dest += done * req_comp;
+
 #define STBI__COMBO(a,b)  ((a)*8+(b))
-#define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+#define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1-done; i >= 0; --i, src += a, dest += b)
         // convert source image with img_n components to one with req_comp components;
         // avoid switch per pixel, so use switch per scanline and massive macros
         switch (STBI__COMBO(img_n, req_comp)) {
@@ -1793,6 +2306,11 @@ static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int r
     STBI_FREE(data);
     return good;
 }
+
+static stbi__uint16* stbi__convert_format16(stbi__uint16* data, int img_n, int req_comp, unsigned int x, unsigned int y)
+{
+    return stbi__convert_format16_level(data, img_n, req_comp, x, y, stbi__convert_simd_level());
+}
 #endif
 
 #ifndef STBI_NO_LINEAR
@@ -1800,14 +2318,18 @@ static float* stbi__ldr_to_hdr(stbi_uc* data, int x, int y, int comp)
 {
     int i, k, n;
     float* output;
+    float table[256];
     if (!data) return NULL;
     output = (float*)stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
     if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
     // compute number of non-alpha components
     if (comp & 1) n = comp; else n = comp - 1;
+    // one pow per possible value rather than per sample
+    for (i = 0; i < 256; ++i)
+        table[i] = (float)(pow(i / 255.0f, stbi__l2h_gamma) * stbi__l2h_scale);
     for (i = 0; i < x * y; ++i) {
         for (k = 0; k < n; ++k) {
-            output[i * comp + k] = (float)(pow(data[i * comp + k] / 255.0f, stbi__l2h_gamma) * stbi__l2h_scale);
+            output[i * comp + k] = table[data[i * comp + k]];
         }
     }
     if (n < comp) {
@@ -1931,6 +2453,8 @@ typedef struct
     int            jfif;
     int            app14_color_transform; // Adobe APP14 tag
     int            rgb;
+    int            preview_comp;          // req_comp of the load, for the progressive preview
+    int            preview_dc;            // components whose first DC scan is done
 
     int scan_n, order[4];
     int restart_interval, todo;
@@ -2073,6 +2597,8 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg* j, stbi__huffman* h)
 
     // convert the huffman code to the symbol id
     c = ((j->code_buffer >> (32 - k)) & stbi__bmask[k]) + h->delta[k];
+    if (c < 0 || c >= 256) // a corrupt table can map a code past the symbols
+        return -1;
     STBI_ASSERT((((j->code_buffer) >> (32 - h->size[c])) & stbi__bmask[h->size[c]]) == h->code[c]);
 
     // convert the id to a symbol
@@ -2090,11 +2616,12 @@ stbi_inline static int stbi__extend_receive(stbi__jpeg* j, int n)
 {
     unsigned int k;
     int sgn;
+    if (n < 0 || n >= (int)(sizeof(stbi__bmask) / sizeof(*stbi__bmask))) return 0;
     if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
+    if (j->code_bits < n) return 0; // ran out of bits from stream, return 0s instead of continuing
 
     sgn = (stbi__int32)j->code_buffer >> 31; // sign bit is always in MSB
     k = stbi_lrot(j->code_buffer, n);
-    if (n < 0 || n >= (int)(sizeof(stbi__bmask) / sizeof(*stbi__bmask))) return 0;
     j->code_buffer = k & ~stbi__bmask[n];
     k &= stbi__bmask[n];
     j->code_bits -= n;
@@ -2106,6 +2633,7 @@ stbi_inline static int stbi__jpeg_get_bits(stbi__jpeg* j, int n)
 {
     unsigned int k;
     if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
+    if (j->code_bits < n) return 0; // ran out of bits from stream, return 0s instead of continuing
     k = stbi_lrot(j->code_buffer, n);
     j->code_buffer = k & ~stbi__bmask[n];
     k &= stbi__bmask[n];
@@ -2117,6 +2645,7 @@ stbi_inline static int stbi__jpeg_get_bit(stbi__jpeg* j)
 {
     unsigned int k;
     if (j->code_bits < 1) stbi__grow_buffer_unsafe(j);
+    if (j->code_bits < 1) return 0; // ran out of bits from stream, return 0s instead of continuing
     k = j->code_buffer;
     j->code_buffer <<= 1;
     --j->code_bits;
@@ -2212,7 +2741,7 @@ static int stbi__jpeg_decode_block_prog_dc(stbi__jpeg* j, short data[64], stbi__
 
         dc = j->img_comp[b].dc_pred + diff;
         j->img_comp[b].dc_pred = dc;
-        data[0] = (short)(dc << j->succ_low);
+        data[0] = (short)(dc * (1 << j->succ_low));
     }
     else {
         // refinement scan for DC coefficient
@@ -2250,7 +2779,7 @@ static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg* j, short data[64], stbi__
                 j->code_buffer <<= s;
                 j->code_bits -= s;
                 zig = stbi__jpeg_dezigzag[k++];
-                data[zig] = (short)((r >> 8) << shift);
+                data[zig] = (short)((r >> 8) * (1 << shift));
             }
             else {
                 int rs = stbi__jpeg_huff_decode(j, hac);
@@ -2270,7 +2799,7 @@ static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg* j, short data[64], stbi__
                 else {
                     k += r;
                     zig = stbi__jpeg_dezigzag[k++];
-                    data[zig] = (short)(stbi__extend_receive(j, s) << shift);
+                    data[zig] = (short)(stbi__extend_receive(j, s) * (1 << shift));
                 }
             }
         } while (k <= j->spec_end);
@@ -2643,6 +3172,132 @@ static void stbi__idct_simd(stbi_uc* out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT. this is the generic C version run on all eight columns
+// (then all eight rows) at once in 32-bit lanes, so it's bit-identical to it.
+#define stbi__mul_avx2(a, k)  _mm256_mullo_epi32((a), _mm256_set1_epi32(stbi__f2f(k)))
+
+static STBI__AVX2_TARGET void stbi__idct_1d_avx2(__m256i v[8], int bias, int shift)
+{
+    __m256i t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3;
+    __m256i b = _mm256_set1_epi32(bias);
+    __m128i sh = _mm_cvtsi32_si128(shift);
+
+    // even part
+    p2 = v[2];
+    p3 = v[6];
+    p1 = stbi__mul_avx2(_mm256_add_epi32(p2, p3), 0.5411961f);
+    t2 = _mm256_add_epi32(p1, stbi__mul_avx2(p3, -1.847759065f));
+    t3 = _mm256_add_epi32(p1, stbi__mul_avx2(p2, 0.765366865f));
+    p2 = v[0];
+    p3 = v[4];
+    t0 = _mm256_slli_epi32(_mm256_add_epi32(p2, p3), 12);
+    t1 = _mm256_slli_epi32(_mm256_sub_epi32(p2, p3), 12);
+    x0 = _mm256_add_epi32(t0, t3);
+    x3 = _mm256_sub_epi32(t0, t3);
+    x1 = _mm256_add_epi32(t1, t2);
+    x2 = _mm256_sub_epi32(t1, t2);
+
+    // odd part
+    t0 = v[7];
+    t1 = v[5];
+    t2 = v[3];
+    t3 = v[1];
+    p3 = _mm256_add_epi32(t0, t2);
+    p4 = _mm256_add_epi32(t1, t3);
+    p1 = _mm256_add_epi32(t0, t3);
+    p2 = _mm256_add_epi32(t1, t2);
+    p5 = stbi__mul_avx2(_mm256_add_epi32(p3, p4), 1.175875602f);
+    t0 = stbi__mul_avx2(t0, 0.298631336f);
+    t1 = stbi__mul_avx2(t1, 2.053119869f);
+    t2 = stbi__mul_avx2(t2, 3.072711026f);
+    t3 = stbi__mul_avx2(t3, 1.501321110f);
+    p1 = _mm256_add_epi32(p5, stbi__mul_avx2(p1, -0.899976223f));
+    p2 = _mm256_add_epi32(p5, stbi__mul_avx2(p2, -2.562915447f));
+    p3 = stbi__mul_avx2(p3, -1.961570560f);
+    p4 = stbi__mul_avx2(p4, -0.390180644f);
+    t3 = _mm256_add_epi32(t3, _mm256_add_epi32(p1, p4));
+    t2 = _mm256_add_epi32(t2, _mm256_add_epi32(p2, p3));
+    t1 = _mm256_add_epi32(t1, _mm256_add_epi32(p2, p4));
+    t0 = _mm256_add_epi32(t0, _mm256_add_epi32(p1, p3));
+
+    // rounding bias, then descale
+    x0 = _mm256_add_epi32(x0, b);
+    x1 = _mm256_add_epi32(x1, b);
+    x2 = _mm256_add_epi32(x2, b);
+    x3 = _mm256_add_epi32(x3, b);
+    v[0] = _mm256_sra_epi32(_mm256_add_epi32(x0, t3), sh);
+    v[7] = _mm256_sra_epi32(_mm256_sub_epi32(x0, t3), sh);
+    v[1] = _mm256_sra_epi32(_mm256_add_epi32(x1, t2), sh);
+    v[6] = _mm256_sra_epi32(_mm256_sub_epi32(x1, t2), sh);
+    v[2] = _mm256_sra_epi32(_mm256_add_epi32(x2, t1), sh);
+    v[5] = _mm256_sra_epi32(_mm256_sub_epi32(x2, t1), sh);
+    v[3] = _mm256_sra_epi32(_mm256_add_epi32(x3, t0), sh);
+    v[4] = _mm256_sra_epi32(_mm256_sub_epi32(x3, t0), sh);
+}
+
+static STBI__AVX2_TARGET void stbi__transpose_avx2(__m256i v[8])
+{
+    __m256i a0 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i a1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i a2 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i a3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i a4 = _mm256_unpacklo_epi32(v[4], v[5]);
+    __m256i a5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i a6 = _mm256_unpacklo_epi32(v[6], v[7]);
+    __m256i a7 = _mm256_unpackhi_epi32(v[6], v[7]);
+    __m256i b0 = _mm256_unpacklo_epi64(a0, a2);
+    __m256i b1 = _mm256_unpackhi_epi64(a0, a2);
+    __m256i b2 = _mm256_unpacklo_epi64(a1, a3);
+    __m256i b3 = _mm256_unpackhi_epi64(a1, a3);
+    __m256i b4 = _mm256_unpacklo_epi64(a4, a6);
+    __m256i b5 = _mm256_unpackhi_epi64(a4, a6);
+    __m256i b6 = _mm256_unpacklo_epi64(a5, a7);
+    __m256i b7 = _mm256_unpackhi_epi64(a5, a7);
+    v[0] = _mm256_permute2x128_si256(b0, b4, 0x20);
+    v[1] = _mm256_permute2x128_si256(b1, b5, 0x20);
+    v[2] = _mm256_permute2x128_si256(b2, b6, 0x20);
+    v[3] = _mm256_permute2x128_si256(b3, b7, 0x20);
+    v[4] = _mm256_permute2x128_si256(b0, b4, 0x31);
+    v[5] = _mm256_permute2x128_si256(b1, b5, 0x31);
+    v[6] = _mm256_permute2x128_si256(b2, b6, 0x31);
+    v[7] = _mm256_permute2x128_si256(b3, b7, 0x31);
+}
+
+static STBI__AVX2_TARGET void stbi__idct_avx2(stbi_uc* out, int out_stride, short data[64])
+{
+    __m256i v[8];
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i;
+
+    for (i = 0; i < 8; ++i)
+        v[i] = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*) (data + i * 8)));
+
+    // columns: constants scale by 1<<12, keep 2 extra bits of precision
+    stbi__idct_1d_avx2(v, 512, 10);
+    stbi__transpose_avx2(v);
+
+    // rows: remove 1<<17 with rounding, and bias -128..127 up to 0..255
+    stbi__idct_1d_avx2(v, 65536 + (128 << 17), 17);
+    stbi__transpose_avx2(v);
+
+    // saturating packs do the clamp, then put each row's 8 bytes back together
+    for (i = 0; i < 8; i += 4) {
+        __m256i p01 = _mm256_packs_epi32(v[i + 0], v[i + 1]);
+        __m256i p23 = _mm256_packs_epi32(v[i + 2], v[i + 3]);
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(p01, p23), order);
+        __m128i lo = _mm256_castsi256_si128(bytes);
+        __m128i hi = _mm256_extracti128_si256(bytes, 1);
+        _mm_storel_epi64((__m128i*) out, lo); out += out_stride;
+        _mm_storel_epi64((__m128i*) out, _mm_unpackhi_epi64(lo, lo)); out += out_stride;
+        _mm_storel_epi64((__m128i*) out, hi); out += out_stride;
+        _mm_storel_epi64((__m128i*) out, _mm_unpackhi_epi64(hi, hi)); out += out_stride;
+    }
+}
+
+#undef stbi__mul_avx2
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -3013,6 +3668,166 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg* z)
     }
 }
 
+// restart markers reset the entropy decoder and the dc prediction, so the intervals
+// between them in a baseline scan can be decoded independently. every task below
+// decodes a run of intervals with its own copy of the decoder state; the blocks they
+// write never overlap.
+#define STBI__JPEG_MAX_SCAN_TASKS  128
+
+typedef struct
+{
+    stbi__jpeg* z;
+    stbi_uc** starts;  // first byte of every interval, followed by the end of the data
+    int mcus;          // MCUs in the scan
+    int intervals;
+    int intervals_per_task;
+    int* ok;           // result of every task
+    stbi_uc* end;      // where the last interval left the stream
+    stbi_uc end_marker;
+} stbi__jpeg_scan_job;
+
+// decode 'count' MCUs of a baseline scan, starting from MCU 'first' in scan order
+static int stbi__jpeg_decode_mcus(stbi__jpeg* z, int first, int count)
+{
+    STBI_SIMD_ALIGN(short, data[64]);
+    int m, k, x, y;
+    if (z->scan_n == 1) {
+        // non-interleaved, every block is an MCU
+        int n = z->order[0];
+        int w = (z->img_comp[n].x + 7) >> 3;
+        int ha = z->img_comp[n].ha;
+        for (m = first; m < first + count; ++m) {
+            int i = m % w, j = m / w;
+            if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+            z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * j * 8 + i * 8, z->img_comp[n].w2, data);
+        }
+    }
+    else {
+        for (m = first; m < first + count; ++m) {
+            int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+            for (k = 0; k < z->scan_n; ++k) {
+                int n = z->order[k];
+                for (y = 0; y < z->img_comp[n].v; ++y) {
+                    for (x = 0; x < z->img_comp[n].h; ++x) {
+                        int x2 = (i * z->img_comp[n].h + x) * 8;
+                        int y2 = (j * z->img_comp[n].v + y) * 8;
+                        int ha = z->img_comp[n].ha;
+                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                        z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2 * y2 + x2, z->img_comp[n].w2, data);
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+static void stbi__jpeg_scan_task(void* task_data, int index)
+{
+    stbi__jpeg_scan_job* job = (stbi__jpeg_scan_job*)task_data;
+    int first = index * job->intervals_per_task;
+    int last = first + job->intervals_per_task;
+    int i, ok;
+    stbi__context s;
+    stbi__jpeg* z = (stbi__jpeg*)stbi__malloc(sizeof(stbi__jpeg));
+    if (last > job->intervals) last = job->intervals;
+    ok = z != NULL;
+    if (z) {
+        memcpy(z, job->z, sizeof(stbi__jpeg));
+        z->s = &s;
+        for (i = first; ok && i < last; ++i) {
+            // each interval reads up to and including its restart marker, the last one up to
+            // the end of the data, exactly what the serial decoder would read
+            int mcu = i * z->restart_interval;
+            int count = job->mcus - mcu < z->restart_interval ? job->mcus - mcu : z->restart_interval;
+            stbi__start_mem(&s, job->starts[i], (int)(job->starts[i + 1] - job->starts[i]));
+            stbi__jpeg_reset(z);
+            ok = stbi__jpeg_decode_mcus(z, mcu, count);
+            // like the serial decoder, look for the marker after every full interval; that
+            // one gives up on the rest of the scan when it isn't there
+            if (ok && count == z->restart_interval) {
+                if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+                if (i + 1 < job->intervals) ok = STBI__RESTART(z->marker);
+                else if (STBI__RESTART(z->marker)) stbi__jpeg_reset(z);
+            }
+        }
+        if (ok && last == job->intervals) {
+            job->end = s.img_buffer;
+            job->end_marker = z->marker;
+        }
+        STBI_FREE(z);
+    }
+    job->ok[index] = ok;
+}
+
+// decodes a baseline scan with restart markers on the caller's threads. returns 0 without
+// consuming anything when the scan doesn't qualify or anything goes wrong, in which case
+// the serial decoder runs instead and reports the error if there is one.
+static int stbi__parse_entropy_coded_data_mt(stbi__jpeg* z)
+{
+    stbi__context* s = z->s;
+    stbi__jpeg_scan_job job;
+    stbi_uc* p, * q, * end;
+    int found, tasks, i, ok;
+
+    if (!s->parallel_for || s->read_from_callbacks || z->progressive || !z->restart_interval)
+        return 0;
+
+    if (z->scan_n == 1) {
+        int n = z->order[0];
+        job.mcus = ((z->img_comp[n].x + 7) >> 3) * ((z->img_comp[n].y + 7) >> 3);
+    }
+    else {
+        job.mcus = z->img_mcu_x * z->img_mcu_y;
+    }
+    job.intervals = (job.mcus + z->restart_interval - 1) / z->restart_interval;
+    if (job.intervals < 2) return 0;
+
+    job.starts = (stbi_uc**)stbi__malloc_mad2(job.intervals + 1, sizeof(stbi_uc*), 0);
+    if (!job.starts) return 0;
+
+    // find the restart markers, stepping over stuffed zeros and fill bytes, up to the
+    // marker that ends the scan
+    p = s->img_buffer;
+    end = s->img_buffer_end;
+    job.starts[0] = p;
+    found = 1;
+    for (;;) {
+        p = (stbi_uc*)memchr(p, 0xff, end - p);
+        if (!p) break;
+        q = p + 1;
+        while (q < end && *q == 0xff) ++q;
+        if (q == end) break;
+        if (*q == 0) { p = q + 1; continue; }
+        if (!STBI__RESTART(*q)) break;
+        if (found == job.intervals) { found = 0; break; } // more markers than intervals
+        job.starts[found++] = q + 1;
+        p = q + 1;
+    }
+    if (found != job.intervals) { STBI_FREE(job.starts); return 0; }
+    job.starts[job.intervals] = end;
+
+    tasks = job.intervals < STBI__JPEG_MAX_SCAN_TASKS ? job.intervals : STBI__JPEG_MAX_SCAN_TASKS;
+    job.intervals_per_task = (job.intervals + tasks - 1) / tasks;
+    tasks = (job.intervals + job.intervals_per_task - 1) / job.intervals_per_task;
+    job.z = z;
+    job.ok = (int*)stbi__malloc_mad2(tasks, sizeof(int), 0);
+    if (!job.ok) { STBI_FREE(job.starts); return 0; }
+
+    s->parallel_for(s->parallel_user, tasks, stbi__jpeg_scan_task, &job);
+
+    ok = 1;
+    for (i = 0; i < tasks; ++i)
+        ok &= job.ok[i];
+    STBI_FREE(job.ok);
+    STBI_FREE(job.starts);
+    if (!ok) return 0;
+
+    s->img_buffer = job.end;
+    z->marker = job.end_marker;
+    return 1;
+}
+
 static void stbi__jpeg_dequantize(short* data, stbi__uint16* dequant)
 {
     int i;
@@ -3079,6 +3894,7 @@ static int stbi__process_marker(stbi__jpeg* z, int m)
                 sizes[i] = stbi__get8(z->s);
                 n += sizes[i];
             }
+            if (n > 256) return stbi__err("bad DHT header", "Corrupt JPEG"); // more symbols than the tables hold
             L -= 17;
             if (tc == 0) {
                 if (!stbi__build_huffman(z->huff_dc + th, sizes)) return 0;
@@ -3324,10 +4140,83 @@ static int stbi__decode_jpeg_header(stbi__jpeg* z, int scan)
     return 1;
 }
 
+// progressive preview: with only DC coefficients every 8x8 block is flat, so one pixel
+// per block is the image at 1/8 scale. chroma blocks are repeated to cover subsampling.
+static void stbi__jpeg_preview(stbi__jpeg* z)
+{
+    int img_n = z->s->img_n;
+    int n = z->preview_comp ? z->preview_comp : img_n >= 3 ? 3 : 1;
+    int w = (z->s->img_x + 7) >> 3, h = (z->s->img_y + 7) >> 3;
+    int is_rgb = img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
+    int flip = z->s->flip;
+    int i, j, k;
+    stbi_uc* out, * rows, * rgba;
+
+    if (img_n != 1 && img_n != 3) return; // CMYK previews aren't worth the conversion
+    out = (stbi_uc*)stbi__malloc_mad3(w, h, n, 0);
+    rows = (stbi_uc*)stbi__malloc_mad2(w, 3 + 4, 0);
+    if (!out || !rows) {
+        STBI_FREE(out);
+        STBI_FREE(rows);
+        return;
+    }
+    rgba = rows + 3 * w;
+
+    for (j = 0; j < h; ++j) {
+        stbi_uc* dest = out + (size_t)n * w * (flip ? h - 1 - j : j);
+        for (k = 0; k < img_n; ++k) {
+            // same rounding as the IDCT of a block with only a DC term
+            int by = j * z->img_comp[k].v / z->img_v_max;
+            short* block = z->img_comp[k].coeff + 64 * by * z->img_comp[k].coeff_w;
+            int dq = z->dequant[z->img_comp[k].tq][0];
+            for (i = 0; i < w; ++i) {
+                int bx = i * z->img_comp[k].h / z->img_h_max;
+                rows[k * w + i] = stbi__clamp(((block[64 * bx] * dq + 4) >> 3) + 128);
+            }
+        }
+
+        if (img_n == 1 || (n < 3 && !is_rgb)) {
+            for (i = 0; i < w; ++i) {
+                dest[i * n] = rows[i];
+                if (n == 2) dest[i * 2 + 1] = 255;
+                if (n >= 3) dest[i * n + 1] = dest[i * n + 2] = rows[i];
+                if (n == 4) dest[i * 4 + 3] = 255;
+            }
+            continue;
+        }
+
+        if (is_rgb) {
+            for (i = 0; i < w; ++i) {
+                rgba[i * 4 + 0] = rows[i];
+                rgba[i * 4 + 1] = rows[w + i];
+                rgba[i * 4 + 2] = rows[2 * w + i];
+                rgba[i * 4 + 3] = 255;
+            }
+        }
+        else {
+            z->YCbCr_to_RGB_kernel(rgba, rows, rows + w, rows + 2 * w, w, 4);
+        }
+        for (i = 0; i < w; ++i) {
+            stbi_uc* p = rgba + i * 4;
+            if (n < 3) {
+                dest[i * n] = stbi__compute_y(p[0], p[1], p[2]);
+                if (n == 2) dest[i * 2 + 1] = 255;
+            }
+            else {
+                memcpy(dest + i * n, p, n);
+            }
+        }
+    }
+
+    stbi__preview_callback(stbi__preview_user, out, w, h, n);
+    STBI_FREE(rows);
+    STBI_FREE(out);
+}
+
 // decode image to YCbCr format
 static int stbi__decode_jpeg_image(stbi__jpeg* j)
 {
-    int m;
+    int m, k;
     for (m = 0; m < 4; m++) {
         j->img_comp[m].raw_data = NULL;
         j->img_comp[m].raw_coeff = NULL;
@@ -3338,7 +4227,14 @@ static int stbi__decode_jpeg_image(stbi__jpeg* j)
     while (!stbi__EOI(m)) {
         if (stbi__SOS(m)) {
             if (!stbi__process_scan_header(j)) return 0;
-            if (!stbi__parse_entropy_coded_data(j)) return 0;
+            if (!stbi__parse_entropy_coded_data_mt(j) && !stbi__parse_entropy_coded_data(j)) return 0;
+            if (j->progressive && j->spec_start == 0 && j->succ_high == 0 && stbi__preview_callback) {
+                int all = (1 << j->s->img_n) - 1, before = j->preview_dc;
+                for (k = 0; k < j->scan_n; ++k)
+                    j->preview_dc |= 1 << j->order[k];
+                if (before != all && j->preview_dc == all)
+                    stbi__jpeg_preview(j);
+            }
             if (j->marker == STBI__MARKER_none) {
                 // handle 0s at the end of image data from IP Kamera 9060
                 while (!stbi__at_eof(j->s)) {
@@ -3564,16 +4460,75 @@ static stbi_uc* stbi__resample_row_hv_2_simd(stbi_uc* out, stbi_uc* in_near, stb
 }
 #endif
 
-static stbi_uc* stbi__resample_row_generic(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET stbi_uc* stbi__resample_row_hv_2_avx2(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
 {
-    // resample with nearest-neighbor
-    int i, j;
-    STBI_NOTUSED(in_far);
-    for (i = 0; i < w; ++i)
-        for (j = 0; j < hs; ++j)
-            out[i * hs + j] = in_near[i];
-    return out;
-}
+    // same polyphase filter as the sse2 version, 16 pixels at a time
+    int i = 0, t0, t1;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    t1 = 3 * in_near[0] + in_far[0];
+    for (; i < ((w - 1) & ~15); i += 16) {
+        // vertical pass, 3*x + y = 4*x + (y - x)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*) (in_near + i)));
+        __m256i curr = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+        // byte shifts only work within 128-bit lanes, so shift in the
+        // neighbouring lane (or zero) with alignr
+        __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+        __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+        __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+        __m256i next = _mm256_insert_epi16(nxt0, 3 * in_near[i + 16] + in_far[i + 16], 15);
+
+        // even pixels = cur*4 + (prev - cur), odd pixels = cur*4 + (next - cur)
+        __m256i bias = _mm256_set1_epi16(8);
+        __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+        __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+        __m256i odd = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+        // interleave and undo scaling. unpack and pack both work per lane,
+        // so the two cancel out and the bytes land in order
+        __m256i de0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+        __m256i de1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+        _mm256_storeu_si256((__m256i*) (out + i * 2), _mm256_packus_epi16(de0, de1));
+
+        // "previous" value for next iter
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i) {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+#endif
+
+static stbi_uc* stbi__resample_row_generic(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs)
+{
+    // resample with nearest-neighbor
+    int i, j;
+    STBI_NOTUSED(in_far);
+    for (i = 0; i < w; ++i)
+        for (j = 0; j < hs; ++j)
+            out[i * hs + j] = in_near[i];
+    return out;
+}
 
 // this is a reduced-precision calculation of YCbCr-to-RGB introduced
 // to make sure the code produces the same results in both SIMD and scalar
@@ -3738,6 +4693,68 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc* out, stbi_uc const* y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc* out, stbi_uc const* y, stbi_uc const* pcb, stbi_uc const* pcr, int count, int step)
+{
+    int i = 0;
+
+    // the sse2 transform on 16 pixels at a time, again only for step == 4
+    if (step == 4) {
+        __m128i signflip = _mm_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f * 4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f * 4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f * 4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f * 4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+        for (; i + 15 < count; i += 16) {
+            // load
+            __m128i y_bytes = _mm_loadu_si128((__m128i*) (y + i));
+            __m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i*) (pcr + i)), signflip); // -128
+            __m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i*) (pcb + i)), signflip); // -128
+
+            // widen to short: y<<8 | 128, and cr, cb left-shifted by 8
+            __m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+            __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cr_biased), 8);
+            __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cb_biased), 8);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte and interleave channels, all within 128-bit lanes
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // low lanes hold pixels 0-7, high lanes 8-15
+            _mm256_storeu_si256((__m256i*) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i*) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+        }
+    }
+
+    // the remainder goes through the sse2 path, which ends with the scalar loop
+    stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg* j)
 {
@@ -3753,6 +4770,14 @@ static void stbi__setup_jpeg(stbi__jpeg* j)
     }
 #endif
 
+#ifdef STBI_AVX2
+    if (stbi__avx2_available()) {
+        j->idct_block_kernel = stbi__idct_avx2;
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+    }
+#endif
+
 #ifdef STBI_NEON
     j->idct_block_kernel = stbi__idct_simd;
     j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3783,6 +4808,173 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
     return (stbi_uc)((t + (t >> 8)) >> 8);
 }
 
+// step the resampler on to the next output row
+static void stbi__resample_next_row(stbi__resample* r, int comp_y, int w2)
+{
+    if (++r->ystep >= r->vs) {
+        r->ystep = 0;
+        r->line0 = r->line1;
+        if (++r->ypos < comp_y)
+            r->line1 += w2;
+    }
+}
+
+// resample and color-convert 'rows' output rows, 'stride' bytes apart, continuing from the
+// row res_comp is at. 3 channel rows write one byte past their end; where that byte isn't
+// free, pass a 'scratch' row of n * img_x + 1 bytes for them to go through instead.
+static void stbi__jpeg_convert_rows(stbi__jpeg* z, stbi__resample* res_comp, stbi_uc** linebuf, stbi_uc* output, int stride, int n, int decode_n, int is_rgb, unsigned int rows, stbi_uc* scratch)
+{
+    int k;
+    unsigned int i, j;
+    stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
+    for (j = 0; j < rows; ++j) {
+        stbi_uc* row = output + (ptrdiff_t)stride * j;
+        stbi_uc* out = scratch ? scratch : row;
+        for (k = 0; k < decode_n; ++k) {
+            stbi__resample* r = &res_comp[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                y_bot ? r->line1 : r->line0,
+                y_bot ? r->line0 : r->line1,
+                r->w_lores, r->hs);
+            stbi__resample_next_row(r, z->img_comp[k].y, z->img_comp[k].w2);
+        }
+        if (n >= 3) {
+            stbi_uc* y = coutput[0];
+            if (z->s->img_n == 3) {
+                if (is_rgb) {
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else if (z->s->img_n == 4) {
+                if (z->app14_color_transform == 0) { // CMYK
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                        out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                        out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else if (z->app14_color_transform == 2) { // YCCK
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        stbi_uc m = coutput[3][i];
+                        out[0] = stbi__blinn_8x8(255 - out[0], m);
+                        out[1] = stbi__blinn_8x8(255 - out[1], m);
+                        out[2] = stbi__blinn_8x8(255 - out[2], m);
+                        out += n;
+                    }
+                }
+                else { // YCbCr + alpha?  Ignore the fourth channel for now
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else {
+            if (is_rgb) {
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i)
+                        *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                else {
+                    for (i = 0; i < z->s->img_x; ++i, out += 2) {
+                        out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                        out[1] = 255;
+                    }
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+                for (i = 0; i < z->s->img_x; ++i) {
+                    stbi_uc m = coutput[3][i];
+                    stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+                    stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+                    stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+                    out[0] = stbi__compute_y(r, g, b);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+                    out[1] = 255;
+                    out += n;
+                }
+            }
+            else {
+                stbi_uc* y = coutput[0];
+                if (n == 1)
+                    for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+                else
+                    for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+            }
+        }
+        if (scratch)
+            memcpy(row, scratch, n * z->s->img_x);
+    }
+}
+
+// output rows are converted in bands, each with its own line buffers and resampler
+// state, so that bands can run in parallel
+#define STBI__JPEG_BAND_ROWS  64
+
+typedef struct
+{
+    stbi__jpeg* z;
+    stbi__resample* res_comp; // state at row 0
+    stbi_uc* output;          // row 0
+    int stride;
+    int n, decode_n, is_rgb;
+    int scratch_all;          // rows can't overrun into the next one
+    int* ok;
+} stbi__jpeg_band_job;
+
+static void stbi__jpeg_band_task(void* task_data, int index)
+{
+    stbi__jpeg_band_job* job = (stbi__jpeg_band_job*)task_data;
+    stbi__jpeg* z = job->z;
+    unsigned int j0 = index * STBI__JPEG_BAND_ROWS;
+    unsigned int j1 = j0 + STBI__JPEG_BAND_ROWS < z->s->img_y ? j0 + STBI__JPEG_BAND_ROWS : z->s->img_y;
+    unsigned int j;
+    int k;
+    stbi__resample res_comp[4];
+    stbi_uc* linebuf[4];
+    stbi_uc* scratch;
+    stbi_uc* first = job->output + (ptrdiff_t)job->stride * j0;
+    // line buffers, then a scratch row so the last row can't overrun the next band
+    stbi_uc* buffer = (stbi_uc*)stbi__malloc_mad2(job->decode_n + job->n, z->s->img_x + 3, 0);
+    job->ok[index] = buffer != NULL;
+    if (!buffer) return;
+
+    for (k = 0; k < job->decode_n; ++k) {
+        res_comp[k] = job->res_comp[k];
+        for (j = 0; j < j0; ++j)
+            stbi__resample_next_row(&res_comp[k], z->img_comp[k].y, z->img_comp[k].w2);
+        linebuf[k] = buffer + k * (z->s->img_x + 3);
+    }
+    scratch = buffer + job->decode_n * (z->s->img_x + 3);
+
+    stbi__jpeg_convert_rows(z, res_comp, linebuf, first, job->stride, job->n, job->decode_n, job->is_rgb, j1 - j0 - 1, job->scratch_all ? scratch : NULL);
+    stbi__jpeg_convert_rows(z, res_comp, linebuf, first + (ptrdiff_t)job->stride * (j1 - j0 - 1), job->stride, job->n, job->decode_n, job->is_rgb, 1, scratch);
+    STBI_FREE(buffer);
+}
+
 static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp, int req_comp)
 {
     int n, decode_n, is_rgb;
@@ -3792,6 +4984,8 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
     if (req_comp < 0 || req_comp > 4) return stbi__errpuc("bad req_comp", "Internal error");
 
     // load a jpeg image from whichever source, but leave in YCbCr format
+    z->preview_comp = req_comp;
+    z->preview_dc = 0;
     if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
     // determine actual number of components to generate
@@ -3806,10 +5000,9 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
 
     // resample and color-convert
     {
-        int k;
-        unsigned int i, j;
-        stbi_uc* output;
-        stbi_uc* coutput[4] = { NULL, NULL, NULL, NULL };
+        int k, bands, stride, scratch_all;
+        stbi_uc* result, * output;
+        stbi_uc* linebuf[4];
 
         stbi__resample res_comp[4];
 
@@ -3835,119 +5028,72 @@ static stbi_uc* load_jpeg_image(stbi__jpeg* z, int* out_x, int* out_y, int* comp
             else                               r->resample = stbi__resample_row_generic;
         }
 
-        // can't error after this so, this is safe
-        output = (stbi_uc*)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-        if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+        if (z->s->dest) {
+            // write straight into the caller's rows. with no room past the row end
+            // guaranteed, 3 channel rows all go through scratch
+            if (!stbi__dest_fits(z->s, n * z->s->img_x, z->s->img_y)) { stbi__cleanup_jpeg(z); return stbi__errpuc("dest too small", "Destination too small"); }
+            result = output = z->s->dest;
+            stride = z->s->dest_stride;
+            scratch_all = n == 3;
+        }
+        else {
+            // only the band buffers of the parallel path can fail after this
+            result = output = (stbi_uc*)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+            if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+            stride = n * z->s->img_x;
+            scratch_all = 0;
+        }
+
+        // flip by walking the rows backwards. a 3 channel row can then overrun into
+        // the one written before it, so those go through scratch as well
+        if (z->s->flip) {
+            output += (ptrdiff_t)stride * (z->s->img_y - 1);
+            stride = -stride;
+            scratch_all = n == 3;
+        }
 
         // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j) {
-            stbi_uc* out = output + n * z->s->img_x * j;
-            for (k = 0; k < decode_n; ++k) {
-                stbi__resample* r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                    y_bot ? r->line1 : r->line0,
-                    y_bot ? r->line0 : r->line1,
-                    r->w_lores, r->hs);
-                if (++r->ystep >= r->vs) {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
+        bands = (z->s->img_y + STBI__JPEG_BAND_ROWS - 1) / STBI__JPEG_BAND_ROWS;
+        if (z->s->parallel_for && bands > 1) {
+            stbi__jpeg_band_job job;
+            int ok = 0;
+            job.z = z;
+            job.res_comp = res_comp;
+            job.output = output;
+            job.stride = stride;
+            job.n = n;
+            job.decode_n = decode_n;
+            job.is_rgb = is_rgb;
+            job.scratch_all = scratch_all;
+            job.ok = (int*)stbi__malloc_mad2(bands, sizeof(int), 0);
+            if (job.ok) {
+                z->s->parallel_for(z->s->parallel_user, bands, stbi__jpeg_band_task, &job);
+                for (ok = 1, k = 0; k < bands; ++k)
+                    ok &= job.ok[k];
+                STBI_FREE(job.ok);
             }
-            if (n >= 3) {
-                stbi_uc* y = coutput[0];
-                if (z->s->img_n == 3) {
-                    if (is_rgb) {
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else if (z->s->img_n == 4) {
-                    if (z->app14_color_transform == 0) { // CMYK
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                            out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                            out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else if (z->app14_color_transform == 2) { // YCCK
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            stbi_uc m = coutput[3][i];
-                            out[0] = stbi__blinn_8x8(255 - out[0], m);
-                            out[1] = stbi__blinn_8x8(255 - out[1], m);
-                            out[2] = stbi__blinn_8x8(255 - out[2], m);
-                            out += n;
-                        }
-                    }
-                    else { // YCbCr + alpha?  Ignore the fourth channel for now
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
+            if (!ok) {
+                stbi__cleanup_jpeg(z);
+                if (result != z->s->dest) STBI_FREE(result);
+                return stbi__errpuc("outofmem", "Out of memory");
             }
-            else {
-                if (is_rgb) {
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i)
-                            *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                    else {
-                        for (i = 0; i < z->s->img_x; ++i, out += 2) {
-                            out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                            out[1] = 255;
-                        }
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        stbi_uc m = coutput[3][i];
-                        stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                        stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                        stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                        out[0] = stbi__compute_y(r, g, b);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                        out[1] = 255;
-                        out += n;
-                    }
-                }
-                else {
-                    stbi_uc* y = coutput[0];
-                    if (n == 1)
-                        for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-                    else
-                        for (i = 0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-                }
+        }
+        else {
+            stbi_uc* scratch = NULL;
+            if (scratch_all) {
+                scratch = (stbi_uc*)stbi__malloc_mad2(n, z->s->img_x, 1);
+                if (!scratch) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
             }
+            for (k = 0; k < decode_n; ++k)
+                linebuf[k] = z->img_comp[k].linebuf;
+            stbi__jpeg_convert_rows(z, res_comp, linebuf, output, stride, n, decode_n, is_rgb, z->s->img_y, scratch);
+            STBI_FREE(scratch);
         }
         stbi__cleanup_jpeg(z);
         *out_x = z->s->img_x;
         *out_y = z->s->img_y;
         if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-        return output;
+        return result;
     }
 }
 
@@ -3955,10 +5101,10 @@ static void* stbi__jpeg_load(stbi__context* s, int* x, int* y, int* comp, int re
 {
     unsigned char* result;
     stbi__jpeg* j = (stbi__jpeg*)stbi__malloc(sizeof(stbi__jpeg));
-    STBI_NOTUSED(ri);
     j->s = s;
     stbi__setup_jpeg(j);
     result = load_jpeg_image(j, x, y, comp, req_comp);
+    ri->flipped = s->flip;
     STBI_FREE(j);
     return result;
 }
@@ -4004,12 +5150,17 @@ static int stbi__jpeg_info(stbi__context* s, int* x, int* y, int* comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - 64-bit bit buffer refilled a word at a time
+//      - pairs of short literals decoded with one lookup
+//      - matches copied 8 bytes at a time
 
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
+#define STBI__ZPAIR_BITS  11 // two literals whose codes fit in this many bits decode at once
+#define STBI__ZPAIR_MASK  ((1 << STBI__ZPAIR_BITS) - 1)
 
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
@@ -4097,7 +5248,7 @@ typedef struct
 {
     stbi_uc* zbuffer, * zbuffer_end;
     int num_bits;
-    stbi__uint32 code_buffer;
+    stbi__uint64 code_buffer;
 
     char* zout;
     char* zout_start;
@@ -4105,6 +5256,8 @@ typedef struct
     int   z_expandable;
 
     stbi__zhuffman z_length, z_distance;
+    stbi__uint32 z_pairs[1 << STBI__ZPAIR_BITS]; // (bits << 16) | (second << 8) | first, 0 if no pair
+    int careful_only; // skip stbi__parse_huffman_fast, for checking it against the careful loop
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf* z)
@@ -4120,31 +5273,47 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf* z)
 static void stbi__fill_bits(stbi__zbuf* z)
 {
     do {
-        if (z->code_buffer >= (1U << z->num_bits)) {
+        if (z->num_bits < 0 || z->code_buffer >= ((stbi__uint64)1 << z->num_bits)) {
             z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
             return;
         }
-        z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
+        if (stbi__zeof(z)) return; // no zero padding, a code running past the end is an error
+        z->code_buffer |= (stbi__uint64)*z->zbuffer++ << z->num_bits;
         z->num_bits += 8;
-    } while (z->num_bits <= 24);
+    } while (z->num_bits <= 56);
+}
+
+// little-endian unaligned load, the caller guarantees 8 readable bytes
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc* p)
+{
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    stbi__uint64 v;
+    memcpy(&v, p, 8);
+    return v;
+#else
+    return (stbi__uint64)p[0] | ((stbi__uint64)p[1] << 8) | ((stbi__uint64)p[2] << 16) | ((stbi__uint64)p[3] << 24) |
+        ((stbi__uint64)p[4] << 32) | ((stbi__uint64)p[5] << 40) | ((stbi__uint64)p[6] << 48) | ((stbi__uint64)p[7] << 56);
+#endif
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf* z, int n)
 {
     unsigned int k;
     if (z->num_bits < n) stbi__fill_bits(z);
-    k = z->code_buffer & ((1 << n) - 1);
+    k = (unsigned int)(z->code_buffer & ((1 << n) - 1));
     z->code_buffer >>= n;
     z->num_bits -= n;
     return k;
 }
 
-static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
+// decodes a code longer than the fast table from the low 16 bits of 'bits',
+// stores its length in *size and returns the symbol or -1
+static int stbi__zhuffman_decode_long(stbi__zhuffman* z, stbi__uint64 bits, int* size)
 {
     int b, s, k;
     // not resolved by fast table, so compute it the slow way
     // use jpeg approach, which requires MSbits at top
-    k = stbi__bit_reverse(a->code_buffer, 16);
+    k = stbi__bit_reverse((int)(bits & 0xffff), 16);
     for (s = STBI__ZFAST_BITS + 1; ; ++s)
         if (k < z->maxcode[s])
             break;
@@ -4153,19 +5322,46 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
     b = (k >> (16 - s)) - z->firstcode[s] + z->firstsymbol[s];
     if (b >= sizeof(z->size)) return -1; // some data was corrupt somewhere!
     if (z->size[b] != s) return -1;  // was originally an assert, but report failure instead.
+    *size = s;
+    return z->value[b];
+}
+
+static int stbi__zhuffman_decode_slowpath(stbi__zbuf* a, stbi__zhuffman* z)
+{
+    int s, v = stbi__zhuffman_decode_long(z, a->code_buffer, &s);
+    if (v < 0) return -1;
     a->code_buffer >>= s;
     a->num_bits -= s;
-    return z->value[b];
+    return v;
+}
+
+// out of input with fewer than 16 bits buffered; raw deflate streams can end on
+// a short code, so only fail if the code needs bits that aren't there.
+// num_bits is negative once zreceive has read past the end.
+static int stbi__zhuffman_decode_eof(stbi__zbuf* a, stbi__zhuffman* z)
+{
+    int b, s, v;
+    b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
+    if (b) {
+        s = b >> 9;
+        v = b & 511;
+    }
+    else {
+        v = stbi__zhuffman_decode_long(z, a->code_buffer, &s);
+    }
+    if (v < 0 || s > a->num_bits) return -1;   /* report error for unexpected end of data. */
+    a->code_buffer >>= s;
+    a->num_bits -= s;
+    return v;
 }
 
 stbi_inline static int stbi__zhuffman_decode(stbi__zbuf* a, stbi__zhuffman* z)
 {
     int b, s;
     if (a->num_bits < 16) {
-        if (stbi__zeof(a)) {
-            return -1;   /* report error for unexpected end of data. */
-        }
         stbi__fill_bits(a);
+        if (a->num_bits < 16)
+            return stbi__zhuffman_decode_eof(a, z);
     }
     b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
     if (b) {
@@ -4213,11 +5409,153 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
 
+// fills z_pairs from the fast table of z_length, an entry is set when the low
+// STBI__ZPAIR_BITS bits start with two complete literal codes
+static void stbi__zbuild_pairs(stbi__zbuf* a)
+{
+    const stbi__uint16* fast = a->z_length.fast;
+    int i;
+    // not worth it for a block that can't be much bigger than the table
+    if (a->zbuffer_end - a->zbuffer < (1 << STBI__ZPAIR_BITS)) {
+        memset(a->z_pairs, 0, sizeof(a->z_pairs));
+        return;
+    }
+    for (i = 0; i < (1 << STBI__ZPAIR_BITS); ++i) {
+        int b1 = fast[i & STBI__ZFAST_MASK], b2, s1, s2;
+        stbi__uint32 pair = 0;
+        if (b1 && (b1 & 511) < 256) {
+            s1 = b1 >> 9;
+            b2 = fast[(i >> s1) & STBI__ZFAST_MASK];
+            s2 = b2 >> 9;
+            // the second lookup only saw STBI__ZPAIR_BITS - s1 real bits
+            if (b2 && (b2 & 511) < 256 && s1 + s2 <= STBI__ZPAIR_BITS)
+                pair = (stbi__uint32)(((s1 + s2) << 16) | ((b2 & 511) << 8) | (b1 & 511));
+        }
+        a->z_pairs[i] = pair;
+    }
+}
+
+// Decodes with the bit buffer in locals for as long as 8 bytes of input and room
+// for the longest match plus a wide copy remain, so no symbol needs bounds checks.
+// Returns 1 at the end of the block, 0 when the careful loop has to take over,
+// -1 on corrupt data.
+static int stbi__parse_huffman_fast(stbi__zbuf* a, char** pzout)
+{
+    stbi__uint64 bits = a->code_buffer;
+    int num_bits = a->num_bits;
+    stbi_uc* in = a->zbuffer;
+    char* zout = *pzout;
+    int result = 0;
+
+    while (a->zbuffer_end - in >= 8 && a->zout_end - zout >= 258 + 8) {
+        stbi_uc* p;
+        int b, s, z, len, dist, extra;
+        // a length/distance pair takes at most 15+5+15+13 = 48 bits
+        if (num_bits < 48) {
+            int bytes = (63 - num_bits) >> 3;
+            bits |= (stbi__zload64(in) & (((stbi__uint64)1 << (bytes * 8)) - 1)) << num_bits;
+            in += bytes;
+            num_bits += bytes * 8;
+        }
+
+        b = (int)a->z_pairs[bits & STBI__ZPAIR_MASK];
+        if (b) {
+            zout[0] = (char)(b & 255);
+            zout[1] = (char)((b >> 8) & 255);
+            zout += 2;
+            s = b >> 16;
+            bits >>= s;
+            num_bits -= s;
+            continue;
+        }
+
+        b = a->z_length.fast[bits & STBI__ZFAST_MASK];
+        if (b) {
+            s = b >> 9;
+            z = b & 511;
+        }
+        else {
+            z = stbi__zhuffman_decode_long(&a->z_length, bits, &s);
+            if (z < 0) { stbi__err("bad huffman code", "Corrupt PNG"); return -1; }
+        }
+        bits >>= s;
+        num_bits -= s;
+        if (z < 256) {
+            *zout++ = (char)z;
+            continue;
+        }
+        if (z == 256) {
+            result = 1;
+            break;
+        }
+
+        z -= 257;
+        if (z >= 29) { stbi__err("bad huffman code", "Corrupt PNG"); return -1; } // length codes 286 and 287 must not appear
+        extra = stbi__zlength_extra[z];
+        len = stbi__zlength_base[z] + (int)(bits & ((1 << extra) - 1));
+        bits >>= extra;
+        num_bits -= extra;
+
+        b = a->z_distance.fast[bits & STBI__ZFAST_MASK];
+        if (b) {
+            s = b >> 9;
+            z = b & 511;
+        }
+        else {
+            z = stbi__zhuffman_decode_long(&a->z_distance, bits, &s);
+            if (z < 0) { stbi__err("bad huffman code", "Corrupt PNG"); return -1; }
+        }
+        if (z >= 30) { stbi__err("bad huffman code", "Corrupt PNG"); return -1; } // nor distance codes 30 and 31
+        bits >>= s;
+        num_bits -= s;
+        extra = stbi__zdist_extra[z];
+        dist = stbi__zdist_base[z] + (int)(bits & ((1 << extra) - 1));
+        bits >>= extra;
+        num_bits -= extra;
+        if (zout - a->zout_start < dist) { stbi__err("bad dist", "Corrupt PNG"); return -1; }
+
+        p = (stbi_uc*)(zout - dist);
+        if (dist >= 8) {
+            // source and destination words never overlap; up to 7 bytes past the
+            // match get written too and are overwritten by whatever comes next
+            char* end = zout + len;
+            do {
+                memcpy(zout, p, 8);
+                zout += 8;
+                p += 8;
+            } while (zout < end);
+            zout = end;
+        }
+        else if (dist == 1) { // run of one byte; common in images.
+            memset(zout, *p, len);
+            zout += len;
+        }
+        else {
+            while (len--) *zout++ = *p++;
+        }
+    }
+
+    a->code_buffer = bits;
+    a->num_bits = num_bits;
+    a->zbuffer = in;
+    *pzout = zout;
+    return result;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf* a)
 {
     char* zout = a->zout;
     for (;;) {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z, fast;
+        fast = a->careful_only ? 0 : stbi__parse_huffman_fast(a, &zout);
+        if (fast) {
+            if (fast < 0) return 0;
+            a->zout = zout;
+            return 1;
+        }
+
+        // close to the end of the input or output, one symbol at a time
+        z = stbi__zhuffman_decode(a, &a->z_length);
         if (z < 256) {
             if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG"); // error in huffman codes
             if (zout >= a->zout_end) {
@@ -4234,10 +5572,11 @@ static int stbi__parse_huffman_block(stbi__zbuf* a)
                 return 1;
             }
             z -= 257;
+            if (z >= 29) return stbi__err("bad huffman code", "Corrupt PNG"); // length codes 286 and 287 must not appear
             len = stbi__zlength_base[z];
             if (stbi__zlength_extra[z]) len += stbi__zreceive(a, stbi__zlength_extra[z]);
             z = stbi__zhuffman_decode(a, &a->z_distance);
-            if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG");
+            if (z < 0 || z >= 30) return stbi__err("bad huffman code", "Corrupt PNG"); // nor distance codes 30 and 31
             dist = stbi__zdist_base[z];
             if (stbi__zdist_extra[z]) dist += stbi__zreceive(a, stbi__zdist_extra[z]);
             if (zout - a->zout_start < dist) return stbi__err("bad dist", "Corrupt PNG");
@@ -4307,35 +5646,45 @@ static int stbi__compute_huffman_codes(stbi__zbuf* a)
     if (n != ntot) return stbi__err("bad codelengths", "Corrupt PNG");
     if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
     if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist)) return 0;
+    stbi__zbuild_pairs(a);
     return 1;
 }
 
 static int stbi__parse_uncompressed_block(stbi__zbuf* a)
 {
-    stbi_uc header[4];
-    int len, nlen, k;
+    stbi_uc header[4], buffered[8];
+    int len, nlen, k, n, used;
     if (a->num_bits & 7)
         stbi__zreceive(a, a->num_bits & 7); // discard
-     // drain the bit-packed data into header
-    k = 0;
+     // drain the bit-packed data, the 64-bit buffer can hold more than the header
+    n = 0;
     while (a->num_bits > 0) {
-        header[k++] = (stbi_uc)(a->code_buffer & 255); // suppress MSVC run-time check
+        buffered[n++] = (stbi_uc)(a->code_buffer & 255); // suppress MSVC run-time check
         a->code_buffer >>= 8;
         a->num_bits -= 8;
     }
     if (a->num_bits < 0) return stbi__err("zlib corrupt", "Corrupt PNG");
     // now fill header the normal way
-    while (k < 4)
-        header[k++] = stbi__zget8(a);
+    for (k = 0; k < 4; ++k)
+        header[k] = k < n ? buffered[k] : stbi__zget8(a);
     len = header[1] * 256 + header[0];
     nlen = header[3] * 256 + header[2];
     if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt", "Corrupt PNG");
-    if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer", "Corrupt PNG");
+    // drained bytes after the header are the start of the stored data
+    used = n > 4 ? n - 4 : 0;
+    if (used > len) used = len;
+    if (a->zbuffer + (len - used) > a->zbuffer_end) return stbi__err("read past buffer", "Corrupt PNG");
     if (a->zout + len > a->zout_end)
         if (!stbi__zexpand(a, a->zout, len)) return 0;
-    memcpy(a->zout, a->zbuffer, len);
-    a->zbuffer += len;
+    if (used) memcpy(a->zout, buffered + 4, used);
+    memcpy(a->zout + used, a->zbuffer, len - used);
+    a->zbuffer += len - used;
     a->zout += len;
+    // and whatever is left belongs to the next block
+    for (k = 4 + used; k < n; ++k) {
+        a->code_buffer |= (stbi__uint64)buffered[k] << a->num_bits;
+        a->num_bits += 8;
+    }
     return 1;
 }
 
@@ -4403,6 +5752,7 @@ static int stbi__parse_zlib(stbi__zbuf* a, int parse_header)
                 // use fixed code lengths
                 if (!stbi__zbuild_huffman(&a->z_length, stbi__zdefault_length, 288)) return 0;
                 if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32)) return 0;
+                memset(a->z_pairs, 0, sizeof(a->z_pairs)); // literals are 8 or 9 bits, no pair fits
             }
             else {
                 if (!stbi__compute_huffman_codes(a)) return 0;
@@ -4419,6 +5769,7 @@ static int stbi__do_zlib(stbi__zbuf* a, char* obuf, int olen, int exp, int parse
     a->zout = obuf;
     a->zout_end = obuf + olen;
     a->z_expandable = exp;
+    a->careful_only = 0;
 
     return stbi__parse_zlib(a, parse_header);
 }
@@ -4549,19 +5900,18 @@ enum {
     STBI__F_sub = 1,
     STBI__F_up = 2,
     STBI__F_avg = 3,
-    STBI__F_paeth = 4,
-    // synthetic filters used for first scanline to avoid needing a dummy row of 0s
-    STBI__F_avg_first,
-    STBI__F_paeth_first
+    STBI__F_paeth = 4
 };
 
+// the first scanline is unfiltered against a row of 0s, which turns
+// Up into a copy and Paeth into Sub
 static stbi_uc first_row_filter[5] =
 {
    STBI__F_none,
    STBI__F_sub,
    STBI__F_none,
-   STBI__F_avg_first,
-   STBI__F_paeth_first
+   STBI__F_avg,
+   STBI__F_sub
 };
 
 static int stbi__paeth(int a, int b, int c)
@@ -4577,24 +5927,274 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+// unfilter bytes [start, n) of a row with bpp bytes per pixel; the SIMD
+// versions leave the end of the row to this
+static void stbi__png_unfilter_generic(int filter, stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int start, int n, int bpp)
+{
+    int k = start;
+    switch (filter) {
+    case STBI__F_none:
+        memcpy(cur + k, raw + k, n - k);
+        break;
+    case STBI__F_sub:
+        for (; k < bpp && k < n; ++k) cur[k] = raw[k];
+        for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + cur[k - bpp]);
+        break;
+    case STBI__F_up:
+        for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+        break;
+    case STBI__F_avg:
+        for (; k < bpp && k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + (prior[k] >> 1));
+        for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - bpp]) >> 1));
+        break;
+    case STBI__F_paeth:
+        for (; k < bpp && k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // paeth(0,b,0) is b
+        for (; k < n; ++k) cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - bpp], prior[k], prior[k - bpp]));
+        break;
+    }
+}
+
+// copy an unfiltered row to the output, adding opaque alpha when out_n is
+// img_n+1 and turning 16-bit samples from big-endian into native order
+static void stbi__png_emit_row_generic(stbi_uc* out, const stbi_uc* in, int start, int x, int img_n, int out_n, int depth)
+{
+    int i, k;
+    if (depth == 16) {
+        stbi__uint16* out16 = (stbi__uint16*)out;
+        for (i = start; i < x; ++i) {
+            const stbi_uc* p = in + i * img_n * 2;
+            stbi__uint16* q = out16 + i * out_n;
+            for (k = 0; k < img_n; ++k)
+                q[k] = (stbi__uint16)((p[k * 2] << 8) | p[k * 2 + 1]);
+            if (out_n != img_n) q[img_n] = 0xffff;
+        }
+    }
+    else {
+        for (i = start; i < x; ++i) {
+            const stbi_uc* p = in + i * img_n;
+            stbi_uc* q = out + i * out_n;
+            for (k = 0; k < img_n; ++k)
+                q[k] = p[k];
+            if (out_n != img_n) q[img_n] = 255;
+        }
+    }
+}
+
+#ifdef STBI_SSE2
+// Up is vertical, so it runs 16 bytes at a time. Sub, Avg and Paeth depend on
+// the pixel to the left and run one pixel (bpp 3, 4, 6 or 8) per register.
+// Pixels are loaded and stored 8 bytes at a time; the bytes past bpp are
+// garbage that the next pixel overwrites, so the last 8 bytes of the row are
+// left to the generic version. Returns how many bytes were done.
+static int stbi__png_unfilter_sse2(int filter, stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int n, int bpp)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    int k = 0;
+
+    if (filter == STBI__F_up) {
+        for (; k + 16 <= n; k += 16) {
+            __m128i r = _mm_loadu_si128((const __m128i*) (raw + k));
+            __m128i b = _mm_loadu_si128((const __m128i*) (prior + k));
+            _mm_storeu_si128((__m128i*) (cur + k), _mm_add_epi8(r, b));
+        }
+        return k;
+    }
+    if (bpp < 3 || bpp > 8)
+        return 0;
+
+    switch (filter) {
+    case STBI__F_sub:
+        for (; k + 8 <= n; k += bpp) {
+            a = _mm_add_epi8(_mm_loadl_epi64((const __m128i*) (raw + k)), a);
+            _mm_storel_epi64((__m128i*) (cur + k), a);
+        }
+        break;
+    case STBI__F_avg: {
+        __m128i one = _mm_set1_epi8(1);
+        for (; k + 8 <= n; k += bpp) {
+            __m128i b = _mm_loadl_epi64((const __m128i*) (prior + k));
+            // _mm_avg_epu8 rounds up, take the carry back off where a+b is odd
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(_mm_loadl_epi64((const __m128i*) (raw + k)), avg);
+            _mm_storel_epi64((__m128i*) (cur + k), a);
+        }
+        break;
+    }
+    case STBI__F_paeth:
+        // a, b and c are held as 16-bit lanes so the predictor distances can't overflow
+        for (; k + 8 <= n; k += bpp) {
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (prior + k)), zero);
+            __m128i pa = _mm_sub_epi16(b, c); // p - a
+            __m128i pb = _mm_sub_epi16(a, c); // p - b
+            __m128i pc = _mm_add_epi16(pa, pb); // p - c
+            __m128i smallest, nearest, use, x;
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            // same tie-breaking as stbi__paeth: a, then b, then c
+            use = _mm_cmpeq_epi16(smallest, pc);
+            nearest = _mm_or_si128(_mm_and_si128(use, c), _mm_andnot_si128(use, b));
+            use = _mm_cmpeq_epi16(smallest, pb);
+            nearest = _mm_or_si128(_mm_and_si128(use, b), _mm_andnot_si128(use, nearest));
+            use = _mm_cmpeq_epi16(smallest, pa);
+            nearest = _mm_or_si128(_mm_and_si128(use, a), _mm_andnot_si128(use, nearest));
+            x = _mm_add_epi8(_mm_loadl_epi64((const __m128i*) (raw + k)), _mm_packus_epi16(nearest, nearest));
+            _mm_storel_epi64((__m128i*) (cur + k), x);
+            a = _mm_unpacklo_epi8(x, zero);
+            c = b;
+        }
+        break;
+    }
+    return k;
+}
+
+// returns how many pixels were written, the rest go through the generic version
+static int stbi__png_emit_row_sse2(stbi_uc* out, const stbi_uc* in, int x, int img_n, int out_n, int depth)
+{
+    int i = 0;
+    if (depth == 16) {
+        if (img_n == out_n) {
+            int n = x * img_n * 2;
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+                _mm_storeu_si128((__m128i*) (out + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+            }
+            return i / (img_n * 2);
+        }
+        if (img_n == 1) {
+            __m128i alpha = _mm_set1_epi16(-1);
+            for (; i + 8 <= x; i += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (in + i * 2));
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                _mm_storeu_si128((__m128i*) (out + i * 4), _mm_unpacklo_epi16(v, alpha));
+                _mm_storeu_si128((__m128i*) (out + i * 4 + 16), _mm_unpackhi_epi16(v, alpha));
+            }
+        }
+    }
+    else if (img_n == 1 && out_n == 2) {
+        __m128i alpha = _mm_set1_epi8(-1);
+        for (; i + 16 <= x; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+            _mm_storeu_si128((__m128i*) (out + i * 2), _mm_unpacklo_epi8(v, alpha));
+            _mm_storeu_si128((__m128i*) (out + i * 2 + 16), _mm_unpackhi_epi8(v, alpha));
+        }
+    }
+    return i;
+}
+#endif // STBI_SSE2
+
+#ifdef STBI_AVX2
+STBI__AVX2_TARGET static int stbi__png_unfilter_up_avx2(stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int n)
+{
+    int k = 0;
+    for (; k + 32 <= n; k += 32) {
+        __m256i r = _mm256_loadu_si256((const __m256i*) (raw + k));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (prior + k));
+        _mm256_storeu_si256((__m256i*) (cur + k), _mm256_add_epi8(r, b));
+    }
+    return k;
+}
+
+// RGB to RGBA and the 16-bit byte swap, with or without adding alpha, as
+// in-lane shuffles. Each 128-bit lane loads 16 bytes and uses 12 of them,
+// hence the extra pixels kept back from the end of the row.
+STBI__AVX2_TARGET static int stbi__png_emit_row_avx2(stbi_uc* out, const stbi_uc* in, int x, int img_n, int out_n, int depth)
+{
+    int i = 0;
+    if (depth == 16 && img_n == out_n) {
+        __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        int n = x * img_n * 2;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (in + i));
+            _mm256_storeu_si256((__m256i*) (out + i), _mm256_shuffle_epi8(v, swap));
+        }
+        return i / (img_n * 2);
+    }
+    if (img_n != 3 || out_n != 4)
+        return 0;
+
+    if (depth == 8) {
+        __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+        for (; i + 10 <= x; i += 8) {
+            __m128i lo = _mm_loadu_si128((const __m128i*) (in + i * 3));
+            __m128i hi = _mm_loadu_si128((const __m128i*) (in + i * 3 + 12));
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*) (out + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, spread), alpha));
+        }
+    }
+    else {
+        __m256i spread = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, -1, -1, 7, 6, 9, 8, 11, 10, -1, -1,
+            1, 0, 3, 2, 5, 4, -1, -1, 7, 6, 9, 8, 11, 10, -1, -1);
+        __m256i alpha = _mm256_set1_epi64x((long long)0xffff000000000000ull);
+        for (; i + 5 <= x; i += 4) {
+            __m128i lo = _mm_loadu_si128((const __m128i*) (in + i * 6));
+            __m128i hi = _mm_loadu_si128((const __m128i*) (in + i * 6 + 12));
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*) (out + i * 8), _mm256_or_si256(_mm256_shuffle_epi8(v, spread), alpha));
+        }
+    }
+    return i;
+}
+#endif // STBI_AVX2
+
+// simd is 0 for plain C, 1 for SSE2 and 2 when AVX2 can be used as well
+static void stbi__png_unfilter_row(int filter, stbi_uc* cur, const stbi_uc* prior, const stbi_uc* raw, int n, int bpp, int simd)
+{
+    int k = 0;
+#ifdef STBI_AVX2
+    if (simd == 2 && filter == STBI__F_up)
+        k = stbi__png_unfilter_up_avx2(cur, prior, raw, n);
+#endif
+#ifdef STBI_SSE2
+    if (simd && k == 0)
+        k = stbi__png_unfilter_sse2(filter, cur, prior, raw, n, bpp);
+#endif
+    stbi__png_unfilter_generic(filter, cur, prior, raw, k, n, bpp);
+}
+
+static void stbi__png_emit_row(stbi_uc* out, const stbi_uc* in, int x, int img_n, int out_n, int depth, int simd)
+{
+    int i = 0;
+#ifdef STBI_AVX2
+    if (simd == 2)
+        i = stbi__png_emit_row_avx2(out, in, x, img_n, out_n, depth);
+#endif
+#ifdef STBI_SSE2
+    if (simd && i == 0)
+        i = stbi__png_emit_row_sse2(out, in, x, img_n, out_n, depth);
+#endif
+    stbi__png_emit_row_generic(out, in, i, x, img_n, out_n, depth);
+}
+
 // create the png data from post-deflated data
-static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color, int flip)
 {
     int bytes = (depth == 16 ? 2 : 1);
     stbi__context* s = a->s;
-    stbi__uint32 i, j, stride = x * out_n * bytes;
+    stbi__uint32 j, stride = x * out_n * bytes;
     stbi__uint32 img_len, img_width_bytes;
     int k;
     int img_n = s->img_n; // copy it into a local for later
 
     int output_bytes = out_n * bytes;
     int filter_bytes = img_n * bytes;
-    int width = x;
+    int in_place, simd = 0;
+    stbi_uc* rows, * first;
+    ptrdiff_t step;
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc*)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
     if (!a->out) return stbi__err("outofmem", "Out of memory");
 
+    // flipped rows are written from the bottom of the output up, still unfiltered in file order
+    first = flip ? a->out + (size_t)stride * (y - 1) : a->out;
+    step = flip ? -(ptrdiff_t)stride : (ptrdiff_t)stride;
+
     if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
     img_width_bytes = (((img_n * x * depth) + 7) >> 3);
     img_len = (img_width_bytes + 1) * y;
@@ -4604,110 +6204,64 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
     // so just check for raw_len < img_len always.
     if (raw_len < img_len) return stbi__err("not enough pixels", "Corrupt PNG");
 
+    if (depth < 8) {
+        if (img_width_bytes > x) return stbi__err("invalid width", "Corrupt PNG");
+        filter_bytes = 1;
+    }
+
+    // Rows that are already in output layout (8-bit without added alpha, and
+    // packed sub-byte rows) unfilter in place against the output row above.
+    // The rest unfilter into two scratch rows that are then converted into the
+    // output, so the prior row keeps its file layout. Either way the first row
+    // sees a row of zeros as its prior.
+    in_place = depth < 8 || (depth == 8 && img_n == out_n);
+    rows = (stbi_uc*)stbi__malloc_mad2((int)img_width_bytes, in_place ? 1 : 3, 0);
+    if (!rows) return stbi__err("outofmem", "Out of memory");
+    memset(rows, 0, img_width_bytes);
+
+#ifdef STBI_SSE2
+    if (stbi__sse2_available()) simd = 1;
+#endif
+#ifdef STBI_AVX2
+    if (simd && stbi__avx2_available()) simd = 2;
+#endif
+
     for (j = 0; j < y; ++j) {
-        stbi_uc* cur = a->out + stride * j;
+        stbi_uc* cur;
         stbi_uc* prior;
         int filter = *raw++;
 
-        if (filter > 4)
+        if (filter > 4) {
+            STBI_FREE(rows);
             return stbi__err("invalid filter", "Corrupt PNG");
+        }
 
-        if (depth < 8) {
-            if (img_width_bytes > x) return stbi__err("invalid width", "Corrupt PNG");
-            cur += x * out_n - img_width_bytes; // store output to the rightmost img_len bytes, so we can decode in place
-            filter_bytes = 1;
-            width = img_width_bytes;
+        if (in_place) {
+            cur = first + step * j;
+            if (depth < 8)
+                cur += x * out_n - img_width_bytes; // store output to the rightmost img_len bytes, so we can decode in place
+            prior = j ? cur - step : rows; // bugfix: need to compute this after 'cur +=' computation above
+        }
+        else {
+            cur = rows + img_width_bytes * (1 + (j & 1));
+            prior = j ? rows + img_width_bytes * (2 - (j & 1)) : rows;
         }
-        prior = cur - stride; // bugfix: need to compute this after 'cur +=' computation above
 
         // if first row, use special filter that doesn't sample previous row
         if (j == 0) filter = first_row_filter[filter];
 
-        // handle first byte explicitly
-        for (k = 0; k < filter_bytes; ++k) {
-            switch (filter) {
-            case STBI__F_none: cur[k] = raw[k]; break;
-            case STBI__F_sub: cur[k] = raw[k]; break;
-            case STBI__F_up: cur[k] = STBI__BYTECAST(raw[k] + prior[k]); break;
-            case STBI__F_avg: cur[k] = STBI__BYTECAST(raw[k] + (prior[k] >> 1)); break;
-            case STBI__F_paeth: cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(0, prior[k], 0)); break;
-            case STBI__F_avg_first: cur[k] = raw[k]; break;
-            case STBI__F_paeth_first: cur[k] = raw[k]; break;
-            }
-        }
+        stbi__png_unfilter_row(filter, cur, prior, raw, (int)img_width_bytes, filter_bytes, simd);
+        raw += img_width_bytes;
 
-        if (depth == 8) {
-            if (img_n != out_n)
-                cur[img_n] = 255; // first pixel
-            raw += img_n;
-            cur += out_n;
-            prior += out_n;
-        }
-        else if (depth == 16) {
-            if (img_n != out_n) {
-                cur[filter_bytes] = 255; // first pixel top byte
-                cur[filter_bytes + 1] = 255; // first pixel bottom byte
-            }
-            raw += filter_bytes;
-            cur += output_bytes;
-            prior += output_bytes;
-        }
-        else {
-            raw += 1;
-            cur += 1;
-            prior += 1;
-        }
-
-        // this is a little gross, so that we don't switch per-pixel or per-component
-        if (depth < 8 || img_n == out_n) {
-            int nk = (width - 1) * filter_bytes;
-#define STBI__CASE(f) \
-             case f:     \
-                for (k=0; k < nk; ++k)
-            switch (filter) {
-                // "none" filter turns into a memcpy here; make that explicit.
-            case STBI__F_none:         memcpy(cur, raw, nk); break;
-                STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]); } break;
-                STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-                STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1)); } break;
-                STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes])); } break;
-                STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1)); } break;
-                STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], 0, 0)); } break;
-            }
-#undef STBI__CASE
-            raw += nk;
-        }
-        else {
-            STBI_ASSERT(img_n + 1 == out_n);
-#define STBI__CASE(f) \
-             case f:     \
-                for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
-                   for (k=0; k < filter_bytes; ++k)
-            switch (filter) {
-                STBI__CASE(STBI__F_none) { cur[k] = raw[k]; } break;
-                STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - output_bytes]); } break;
-                STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-                STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - output_bytes]) >> 1)); } break;
-                STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], prior[k], prior[k - output_bytes])); } break;
-                STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - output_bytes] >> 1)); } break;
-                STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - output_bytes], 0, 0)); } break;
-            }
-#undef STBI__CASE
-
-            // the loop above sets the high byte of the pixels' alpha, but for
-            // 16 bit png files we also need the low byte set. we'll do that here.
-            if (depth == 16) {
-                cur = a->out + stride * j; // start at the beginning of the row again
-                for (i = 0; i < x; ++i, cur += output_bytes) {
-                    cur[filter_bytes + 1] = 255;
-                }
-            }
-        }
+        if (!in_place)
+            stbi__png_emit_row(first + step * j, cur, (int)x, img_n, out_n, depth, simd);
     }
+    STBI_FREE(rows);
 
     // we make a separate pass to expand bits to pixels; for performance,
     // this could run two scanlines behind the above code, so it won't
     // intefere with filtering but will still be in the cache.
+    // each row expands within itself, so the pass doesn't care about flipping
     if (depth < 8) {
         for (j = 0; j < y; ++j) {
             stbi_uc* cur = a->out + stride * j;
@@ -4781,18 +6335,6 @@ static int stbi__create_png_image_raw(stbi__png* a, stbi_uc* raw, stbi__uint32 r
             }
         }
     }
-    else if (depth == 16) {
-        // force the image data from big-endian to platform-native.
-        // this is done in a separate pass due to the decoding relying
-        // on the data being untouched, but could probably be done
-        // per-line during decode if care is taken.
-        stbi_uc* cur = a->out;
-        stbi__uint16* cur16 = (stbi__uint16*)cur;
-
-        for (i = 0; i < x * y * out_n; ++i, cur16++, cur += 2) {
-            *cur16 = (cur[0] << 8) | cur[1];
-        }
-    }
 
     return 1;
 }
@@ -4804,7 +6346,7 @@ static int stbi__create_png_image(stbi__png* a, stbi_uc* image_data, stbi__uint3
     stbi_uc* final;
     int p;
     if (!interlaced)
-        return stbi__create_png_image_raw(a, image_data, image_data_len, out_n, a->s->img_x, a->s->img_y, depth, color);
+        return stbi__create_png_image_raw(a, image_data, image_data_len, out_n, a->s->img_x, a->s->img_y, depth, color, a->s->flip);
 
     // de-interlacing
     final = (stbi_uc*)stbi__malloc_mad3(a->s->img_x, a->s->img_y, out_bytes, 0);
@@ -4819,13 +6361,14 @@ static int stbi__create_png_image(stbi__png* a, stbi_uc* image_data, stbi__uint3
         y = (a->s->img_y - yorig[p] + yspc[p] - 1) / yspc[p];
         if (x && y) {
             stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
-            if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
+            if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color, 0)) {
                 STBI_FREE(final);
                 return 0;
             }
             for (j = 0; j < y; ++j) {
                 for (i = 0; i < x; ++i) {
                     int out_y = j * yspc[p] + yorig[p];
+                    if (a->s->flip) out_y = a->s->img_y - 1 - out_y;
                     int out_x = i * xspc[p] + xorig[p];
                     memcpy(final + out_y * a->s->img_x * out_bytes + out_x * out_bytes,
                         a->out + (j * x + i) * out_bytes, out_bytes);
@@ -5197,6 +6740,7 @@ static void* stbi__do_png(stbi__png* p, int* x, int* y, int* n, int req_comp, st
         *x = p->s->img_x;
         *y = p->s->img_y;
         if (n) *n = p->s->img_n;
+        ri->flipped = p->s->flip;
     }
     STBI_FREE(p->out);      p->out = NULL;
     STBI_FREE(p->expanded); p->expanded = NULL;
@@ -5460,8 +7004,7 @@ static void* stbi__bmp_load(stbi__context* s, int* x, int* y, int* comp, int req
             psize = (info.offset - info.extra_read - info.hsz) >> 2;
     }
     if (psize == 0) {
-        STBI_ASSERT(info.offset == s->callback_already_read + (int)(s->img_buffer - s->img_buffer_original));
-        if (info.offset != s->callback_already_read + (s->img_buffer - s->buffer_start)) {
+        if (info.offset != s->callback_already_read + (s->img_buffer - s->img_buffer_original)) {
             return stbi__errpuc("bad offset", "Corrupt BMP");
         }
     }
@@ -5786,7 +7329,7 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
     int RLE_count = 0;
     int RLE_repeating = 0;
     int read_next_pixel = 1;
-    STBI_NOTUSED(ri);
+    stbi_uc* tga_out = NULL;
     STBI_NOTUSED(tga_x_origin); // @TODO
     STBI_NOTUSED(tga_y_origin); // @TODO
 
@@ -5800,6 +7343,8 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
         tga_is_RLE = 1;
     }
     tga_inverted = 1 - ((tga_inverted >> 5) & 1);
+    // a flip on load cancels out the file's own bottom up order, rows go where they end up
+    if (s->flip) tga_inverted = !tga_inverted;
 
     //   If I'm paletted, then I'll use the number of bits from the palette
     if (tga_indexed) tga_comp = stbi__tga_get_comp(tga_palette_bits, 0, &tga_rgb16);
@@ -5914,30 +7459,17 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
                 read_next_pixel = 0;
             } // end of reading a pixel
 
-            // copy data
+            // copy data, to the start of its row in the output at each new row
+            if (i % tga_width == 0) {
+                int row = i / tga_width;
+                tga_out = tga_data + (size_t)(tga_inverted ? tga_height - 1 - row : row) * tga_width * tga_comp;
+            }
             for (j = 0; j < tga_comp; ++j)
-                tga_data[i * tga_comp + j] = raw_data[j];
+                *tga_out++ = raw_data[j];
 
             //   in case we're in RLE mode, keep counting down
             --RLE_count;
         }
-        //   do I need to invert the image?
-        if (tga_inverted)
-        {
-            for (j = 0; j * 2 < tga_height; ++j)
-            {
-                int index1 = j * tga_width * tga_comp;
-                int index2 = (tga_height - 1 - j) * tga_width * tga_comp;
-                for (i = tga_width * tga_comp; i > 0; --i)
-                {
-                    unsigned char temp = tga_data[index1];
-                    tga_data[index1] = tga_data[index2];
-                    tga_data[index2] = temp;
-                    ++index1;
-                    ++index2;
-                }
-            }
-        }
         //   clear my palette, if I had one
         if (tga_palette != NULL)
         {
@@ -5961,6 +7493,7 @@ static void* stbi__tga_load(stbi__context* s, int* x, int* y, int* comp, int req
     // convert to target component count
     if (req_comp && req_comp != tga_comp)
         tga_data = stbi__convert_format(tga_data, tga_comp, req_comp, tga_width, tga_height);
+    ri->flipped = s->flip;
 
     //   the things I do to get rid of an error message, and yet keep
     //   Microsoft's C compilers happy... [8^(
@@ -6923,7 +8456,7 @@ static void* stbi__load_gif_main(stbi__context* s, int** delays, int* x, int* y,
                 }
                 memcpy(out + ((layers - 1) * stride), u, stride);
                 if (layers >= 2) {
-                    two_back = out - 2 * stride;
+                    two_back = out + (layers - 2) * stride;
                 }
 
                 if (delays) {
@@ -6983,6 +8516,98 @@ static int stbi__gif_info(stbi__context* s, int* x, int* y, int* comp)
 {
     return stbi__gif_info_raw(s, x, y, comp);
 }
+
+struct stbi_gif_stream
+{
+    stbi__context s;
+    stbi__gif g;
+    stbi_uc const* buffer;
+    int len;
+    int frame;
+    int done;
+    stbi_uc* back[2]; // frames frame-1 and frame-2 by parity, for dispose mode 3
+};
+
+static void stbi__gif_stream_reset(stbi_gif_stream* gif)
+{
+    STBI_FREE(gif->g.out);
+    STBI_FREE(gif->g.history);
+    STBI_FREE(gif->g.background);
+    memset(&gif->g, 0, sizeof(gif->g));
+    stbi__start_mem(&gif->s, gif->buffer, gif->len);
+    gif->frame = 0;
+    gif->done = 0;
+}
+
+STBIDEF stbi_gif_stream* stbi_gif_stream_open_memory(stbi_uc const* buffer, int len, int* x, int* y)
+{
+    stbi_gif_stream* gif;
+    stbi__context s;
+    int w, h;
+    size_t frame_bytes;
+
+    stbi__start_mem(&s, buffer, len);
+    if (!stbi__gif_test(&s)) return (stbi_gif_stream*)stbi__errpuc("not GIF", "Image was not as a gif type.");
+    if (!stbi__gif_info_raw(&s, &w, &h, NULL)) return NULL;
+    if (w <= 0 || h <= 0 || !stbi__mad3sizes_valid(4, w, h, 0))
+        return (stbi_gif_stream*)stbi__errpuc("too large", "GIF image is too large");
+
+    frame_bytes = (size_t)w * h * 4;
+    gif = (stbi_gif_stream*)stbi__malloc(sizeof(stbi_gif_stream));
+    if (!gif) return (stbi_gif_stream*)stbi__errpuc("outofmem", "Out of memory");
+    memset(gif, 0, sizeof(*gif));
+    gif->buffer = buffer;
+    gif->len = len;
+    gif->back[0] = (stbi_uc*)stbi__malloc(frame_bytes);
+    gif->back[1] = (stbi_uc*)stbi__malloc(frame_bytes);
+    if (!gif->back[0] || !gif->back[1]) {
+        stbi_gif_stream_close(gif);
+        return (stbi_gif_stream*)stbi__errpuc("outofmem", "Out of memory");
+    }
+    stbi__gif_stream_reset(gif);
+
+    *x = w;
+    *y = h;
+    return gif;
+}
+
+STBIDEF stbi_uc* stbi_gif_stream_next(stbi_gif_stream* gif, int* delay_ms)
+{
+    stbi_uc* u;
+    size_t frame_bytes;
+    int comp;
+
+    if (gif->done) return NULL;
+    u = stbi__gif_load_next(&gif->s, &gif->g, &comp, 4, gif->frame >= 2 ? gif->back[gif->frame & 1] : 0);
+    if (u == (stbi_uc*)&gif->s) u = 0;  // end of animated gif marker
+    if (!u) {
+        gif->done = 1;
+        return NULL;
+    }
+
+    // the slot of frame-2 is free once this frame is decoded, and becomes frame-1 for the next
+    frame_bytes = (size_t)gif->g.w * gif->g.h * 4;
+    memcpy(gif->back[gif->frame & 1], u, frame_bytes);
+    gif->frame++;
+    if (delay_ms) *delay_ms = gif->g.delay;
+    return u;
+}
+
+STBIDEF void stbi_gif_stream_rewind(stbi_gif_stream* gif)
+{
+    stbi__gif_stream_reset(gif);
+}
+
+STBIDEF void stbi_gif_stream_close(stbi_gif_stream* gif)
+{
+    if (!gif) return;
+    STBI_FREE(gif->g.out);
+    STBI_FREE(gif->g.history);
+    STBI_FREE(gif->g.background);
+    STBI_FREE(gif->back[0]);
+    STBI_FREE(gif->back[1]);
+    STBI_FREE(gif);
+}
 #endif
 
 // *************************************************************************************************
@@ -7033,12 +8658,57 @@ static char* stbi__hdr_gettoken(stbi__context* z, char* buffer)
     return buffer;
 }
 
+typedef union
+{
+    stbi__uint32 u;
+    float f;
+} stbi__hdr_bits;
+
+// the float bits of m * 2^(e-136), built directly instead of calling ldexp. exact, since
+// m has 8 bits; 0 when either is, or when the result is below the normal float range,
+// which is far below anything the texture formats can represent
+static stbi__uint32 stbi__hdr_float_bits(int m, int e)
+{
+    stbi__hdr_bits v;
+    if (m == 0 || e < 10) return 0;
+    v.f = (float)m;
+    return v.u + ((stbi__uint32)(e - 136) << 23);
+}
+
+// round to nearest even of the float with these bits times 2^scale_log2, for the
+// denormal ranges of the small float formats; matches _mm_cvtps_epi32 in the SIMD path
+static stbi__uint32 stbi__hdr_denormal(stbi__uint32 bits, int scale_log2)
+{
+    stbi__uint32 mant = (bits & 0x7fffff) | 0x800000, q, r, half;
+    int shift = 150 - (int)(bits >> 23) - scale_log2;
+    if (bits == 0 || shift > 24) return 0;
+    q = mant >> shift;
+    r = mant & ((1u << shift) - 1);
+    half = 1u << (shift - 1);
+    return q + (r > half || (r == half && (q & 1)));
+}
+
+// an unsigned small float with a 5-bit exponent biased by 15 and mant_bits of mantissa,
+// rounded to nearest even and clamped to the largest finite value
+static stbi__uint32 stbi__hdr_small_float(stbi__uint32 bits, int mant_bits)
+{
+    int drop = 23 - mant_bits;
+    stbi__uint32 max = (30u << mant_bits) | ((1u << mant_bits) - 1), h;
+    if ((bits >> 23) < 113)
+        h = stbi__hdr_denormal(bits, 14 + mant_bits);
+    else
+        h = ((bits + (1u << (drop - 1)) - 1 + ((bits >> drop) & 1)) >> drop) - (112u << mant_bits);
+    return h > max ? max : h;
+}
+
 static void stbi__hdr_convert(float* output, stbi_uc* input, int req_comp)
 {
     if (input[3] != 0) {
+        stbi__hdr_bits scale;
         float f1;
         // Exponent
-        f1 = (float)ldexp(1.0f, input[3] - (int)(128 + 8));
+        scale.u = input[3] >= 10 ? (stbi__uint32)(input[3] - 9) << 23 : 1u << (input[3] + 13);
+        f1 = scale.f;
         if (req_comp <= 2)
             output[0] = (input[0] + input[1] + input[2]) * f1 / 3;
         else {
@@ -7061,19 +8731,105 @@ static void stbi__hdr_convert(float* output, stbi_uc* input, int req_comp)
     }
 }
 
-static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri)
+static void stbi__hdr_convert_half(stbi__uint16* output, const stbi_uc* input)
+{
+    int k;
+    for (k = 0; k < 3; ++k)
+        output[k] = (stbi__uint16)stbi__hdr_small_float(stbi__hdr_float_bits(input[k], input[3]), 10);
+    output[3] = 0x3c00; // 1.0
+}
+
+static stbi__uint32 stbi__hdr_convert_r11g11b10(const stbi_uc* input)
+{
+    return stbi__hdr_small_float(stbi__hdr_float_bits(input[0], input[3]), 6)
+        | stbi__hdr_small_float(stbi__hdr_float_bits(input[1], input[3]), 6) << 11
+        | stbi__hdr_small_float(stbi__hdr_float_bits(input[2], input[3]), 5) << 22;
+}
+
+#if defined(STBI_SSE2) && (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG))
+#define STBI__HDR_SIMD
+// the same conversions for 4 pixels at a time, with a channel per register: the
+// int to float conversion normalizes the mantissa, adding e - 136 to the float's
+// exponent field scales it, and the small float is then cut out of the float bits
+static __m128i stbi__hdr_float_bits_sse2(__m128i m, __m128i e)
+{
+    __m128i live = _mm_andnot_si128(_mm_cmpeq_epi32(m, _mm_setzero_si128()), _mm_cmpgt_epi32(e, _mm_set1_epi32(9)));
+    __m128i bits = _mm_add_epi32(_mm_castps_si128(_mm_cvtepi32_ps(m)), _mm_slli_epi32(_mm_sub_epi32(e, _mm_set1_epi32(136)), 23));
+    return _mm_and_si128(bits, live);
+}
+
+static __m128i stbi__hdr_small_float_sse2(__m128i bits, int mant_bits)
+{
+    int drop = 23 - mant_bits;
+    __m128i max = _mm_set1_epi32((30 << mant_bits) | ((1 << mant_bits) - 1));
+    __m128i denormal = _mm_cvtps_epi32(_mm_mul_ps(_mm_castsi128_ps(bits), _mm_set1_ps((float)(1 << (14 + mant_bits)))));
+    __m128i round = _mm_add_epi32(_mm_set1_epi32((1 << (drop - 1)) - 1), _mm_and_si128(_mm_srli_epi32(bits, drop), _mm_set1_epi32(1)));
+    __m128i normal = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(bits, round), drop), _mm_set1_epi32(112 << mant_bits));
+    __m128i is_denormal = _mm_cmplt_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(113));
+    __m128i h = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+    __m128i over = _mm_cmpgt_epi32(h, max);
+    return _mm_or_si128(_mm_and_si128(over, max), _mm_andnot_si128(over, h));
+}
+
+// returns how many pixels were converted, the rest go through the generic code
+static int stbi__hdr_convert_row_sse2(void* output, const stbi_uc* input, int width, int format)
+{
+    __m128i bytes = _mm_set1_epi32(0xff);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (input + i * 4));
+        __m128i e = _mm_srli_epi32(v, 24);
+        __m128i r = stbi__hdr_float_bits_sse2(_mm_and_si128(v, bytes), e);
+        __m128i g = stbi__hdr_float_bits_sse2(_mm_and_si128(_mm_srli_epi32(v, 8), bytes), e);
+        __m128i b = stbi__hdr_float_bits_sse2(_mm_and_si128(_mm_srli_epi32(v, 16), bytes), e);
+        if (format == STBI_hdr_rgba16f) {
+            __m128i rg = _mm_or_si128(stbi__hdr_small_float_sse2(r, 10), _mm_slli_epi32(stbi__hdr_small_float_sse2(g, 10), 16));
+            __m128i ba = _mm_or_si128(stbi__hdr_small_float_sse2(b, 10), _mm_set1_epi32(0x3c000000));
+            stbi__uint16* out = (stbi__uint16*)output + i * 4;
+            _mm_storeu_si128((__m128i*) out, _mm_unpacklo_epi32(rg, ba));
+            _mm_storeu_si128((__m128i*) (out + 8), _mm_unpackhi_epi32(rg, ba));
+        }
+        else {
+            __m128i packed = _mm_or_si128(stbi__hdr_small_float_sse2(r, 6),
+                _mm_or_si128(_mm_slli_epi32(stbi__hdr_small_float_sse2(g, 6), 11), _mm_slli_epi32(stbi__hdr_small_float_sse2(b, 5), 22)));
+            _mm_storeu_si128((__m128i*) ((stbi__uint32*)output + i), packed);
+        }
+    }
+    return i;
+}
+#endif
+
+// format is 0 for req_comp floats, or one of the packed STBI_hdr_ formats
+static void stbi__hdr_convert_row(void* output, stbi_uc* input, int width, int req_comp, int format, int simd)
+{
+    int i = 0;
+#ifdef STBI__HDR_SIMD
+    if (simd && format)
+        i = stbi__hdr_convert_row_sse2(output, input, width, format);
+#endif
+    STBI_NOTUSED(simd);
+    for (; i < width; ++i) {
+        if (format == STBI_hdr_rgba16f)
+            stbi__hdr_convert_half((stbi__uint16*)output + i * 4, input + i * 4);
+        else if (format == STBI_hdr_r11g11b10f)
+            ((stbi__uint32*)output)[i] = stbi__hdr_convert_r11g11b10(input + i * 4);
+        else
+            stbi__hdr_convert((float*)output + i * req_comp, input + i * 4, req_comp);
+    }
+}
+
+static void* stbi__hdr_load_main(stbi__context* s, int* x, int* y, int* comp, int req_comp, int format, int flip)
 {
     char buffer[STBI__HDR_BUFLEN];
     char* token;
     int valid = 0;
-    int width, height;
+    int width, height, pixel_bytes, rle, simd = 0;
     stbi_uc* scanline;
-    float* hdr_data;
+    stbi_uc* output;
     int len;
     unsigned char count, value;
     int i, j, k, c1, c2, z;
     const char* headerToken;
-    STBI_NOTUSED(ri);
 
     // Check identifier
     headerToken = stbi__hdr_gettoken(s, buffer);
@@ -7108,60 +8864,51 @@ static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int re
 
     if (comp) *comp = 3;
     if (req_comp == 0) req_comp = 3;
+    pixel_bytes = format == STBI_hdr_rgba16f ? 8 : format == STBI_hdr_r11g11b10f ? 4 : req_comp * (int)sizeof(float);
 
-    if (!stbi__mad4sizes_valid(width, height, req_comp, sizeof(float), 0))
+    if (!stbi__mad3sizes_valid(width, height, pixel_bytes, 0))
         return stbi__errpf("too large", "HDR image is too large");
 
     // Read data
-    hdr_data = (float*)stbi__malloc_mad4(width, height, req_comp, sizeof(float), 0);
-    if (!hdr_data)
+    output = (stbi_uc*)stbi__malloc_mad3(width, height, pixel_bytes, 0);
+    scanline = (stbi_uc*)stbi__malloc_mad2(width, 4, 0);
+    if (!output || !scanline) {
+        STBI_FREE(output);
+        STBI_FREE(scanline);
         return stbi__errpf("outofmem", "Out of memory");
-
-    // Load image data
-    // image data is stored as some number of sca
-    if (width < 8 || width >= 32768) {
-        // Read flat data
-        for (j = 0; j < height; ++j) {
-            for (i = 0; i < width; ++i) {
-                stbi_uc rgbe[4];
-            main_decode_loop:
-                stbi__getn(s, rgbe, 4);
-                stbi__hdr_convert(hdr_data + j * width * req_comp + i * req_comp, rgbe, req_comp);
-            }
-        }
     }
-    else {
-        // Read RLE-encoded data
-        scanline = NULL;
 
-        for (j = 0; j < height; ++j) {
+#ifdef STBI__HDR_SIMD
+    simd = stbi__sse2_available();
+#endif
+
+    // Load image data
+    // image data is stored as some number of scanlines, each is read whole and then
+    // converted into its row of the output
+    rle = width >= 8 && width < 32768;
+    for (j = 0; j < height; ++j) {
+        i = 0;
+        if (rle) {
             c1 = stbi__get8(s);
             c2 = stbi__get8(s);
             len = stbi__get8(s);
             if (c1 != 2 || c2 != 2 || (len & 0x80)) {
                 // not run-length encoded, so we have to actually use THIS data as a decoded
-                // pixel (note this can't be a valid pixel--one of RGB must be >= 128)
-                stbi_uc rgbe[4];
-                rgbe[0] = (stbi_uc)c1;
-                rgbe[1] = (stbi_uc)c2;
-                rgbe[2] = (stbi_uc)len;
-                rgbe[3] = (stbi_uc)stbi__get8(s);
-                stbi__hdr_convert(hdr_data, rgbe, req_comp);
+                // pixel (note this can't be a valid pixel--one of RGB must be >= 128). the
+                // whole image is then read as flat data, starting over from the first row
+                scanline[0] = (stbi_uc)c1;
+                scanline[1] = (stbi_uc)c2;
+                scanline[2] = (stbi_uc)len;
+                scanline[3] = (stbi_uc)stbi__get8(s);
                 i = 1;
                 j = 0;
-                STBI_FREE(scanline);
-                goto main_decode_loop; // yes, this makes no sense
+                rle = 0;
             }
+        }
+        if (rle) {
             len <<= 8;
             len |= stbi__get8(s);
-            if (len != width) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
-            if (scanline == NULL) {
-                scanline = (stbi_uc*)stbi__malloc_mad2(width, 4, 0);
-                if (!scanline) {
-                    STBI_FREE(hdr_data);
-                    return stbi__errpf("outofmem", "Out of memory");
-                }
-            }
+            if (len != width) { STBI_FREE(output); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
 
             for (k = 0; k < 4; ++k) {
                 int nleft;
@@ -7172,26 +8919,34 @@ static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int re
                         // Run
                         value = stbi__get8(s);
                         count -= 128;
-                        if (count > nleft) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                        if (count > nleft) { STBI_FREE(output); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                         for (z = 0; z < count; ++z)
                             scanline[i++ * 4 + k] = value;
                     }
                     else {
-                        // Dump
-                        if (count > nleft) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                        // Dump; a zero count never advances, which is what a truncated file reads as
+                        if (count == 0 || count > nleft) { STBI_FREE(output); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                         for (z = 0; z < count; ++z)
                             scanline[i++ * 4 + k] = stbi__get8(s);
                     }
                 }
             }
-            for (i = 0; i < width; ++i)
-                stbi__hdr_convert(hdr_data + (j * width + i) * req_comp, scanline + i * 4, req_comp);
         }
-        if (scanline)
-            STBI_FREE(scanline);
+        else {
+            // Read flat data
+            if (!stbi__getn(s, scanline + i * 4, (width - i) * 4))
+                memset(scanline + i * 4, 0, (size_t)(width - i) * 4);
+        }
+        stbi__hdr_convert_row(output + (size_t)(flip ? height - 1 - j : j) * width * pixel_bytes, scanline, width, req_comp, format, simd);
     }
+    STBI_FREE(scanline);
+    return output;
+}
 
-    return hdr_data;
+static float* stbi__hdr_load(stbi__context* s, int* x, int* y, int* comp, int req_comp, stbi__result_info* ri)
+{
+    STBI_NOTUSED(ri);
+    return (float*)stbi__hdr_load_main(s, x, y, comp, req_comp, 0, 0);
 }
 
 static int stbi__hdr_info(stbi__context* s, int* x, int* y, int* comp)
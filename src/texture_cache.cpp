@@ -0,0 +1,203 @@
+#include "texture_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static const char CACHE_MAGIC[8] = { 'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t CACHE_VERSION = 1;
+
+// Pixel data starts on a page boundary so levels map cleanly
+static const uint64_t CACHE_ALIGNMENT = 4096;
+
+static uint64_t HashPath(const char* path) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (const char* c = path; *c; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t AlignUp(uint64_t value) {
+	return (value + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+}
+
+TextureCache::TextureCache(const char* cachePath)
+	: path(cachePath) {
+	load();
+}
+
+TextureCache::~TextureCache() {
+	write();
+}
+
+bool TextureCache::makeKey(const char* sourcePath, uint32_t flags, DiskEntry& key) {
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(sourcePath, error);
+	if (error)
+		return false;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(sourcePath, error);
+	if (error)
+		return false;
+
+	memset(&key, 0, sizeof(key));
+	key.pathHash = HashPath(sourcePath);
+	key.sourceSize = (uint64_t)size;
+	key.sourceTime = (int64_t)time.time_since_epoch().count();
+	key.flags = flags;
+	return true;
+}
+
+std::shared_ptr<MipChain> TextureCache::find(const char* sourcePath, uint32_t flags) const {
+	DiskEntry key;
+	if (!mapping.isOpen() || !makeKey(sourcePath, flags, key))
+		return nullptr;
+
+	for (const DiskEntry& entry : index) {
+		if (entry.pathHash != key.pathHash || entry.flags != key.flags)
+			continue;
+		if (entry.sourceSize != key.sourceSize || entry.sourceTime != key.sourceTime)
+			return nullptr;
+
+		std::shared_ptr<MipChain> chain = std::make_shared<MipChain>();
+		LayoutMipChain(entry.width, entry.height, entry.channels, *chain);
+		chain->mapped = mapping.data() + entry.offset;
+		return chain;
+	}
+	return nullptr;
+}
+
+void TextureCache::store(const char* sourcePath, uint32_t flags, const std::shared_ptr<const MipChain>& chain) {
+	PendingEntry stored;
+	if (!makeKey(sourcePath, flags, stored.entry))
+		return;
+
+	stored.entry.size = chain->totalSize();
+	stored.entry.width = chain->width;
+	stored.entry.height = chain->height;
+	stored.entry.channels = chain->channels;
+	stored.chain = chain;
+
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pending.push_back(stored);
+}
+
+void TextureCache::load() {
+	if (!mapping.open(path.c_str()))
+		return;
+
+	const unsigned char* data = mapping.data();
+	size_t size = mapping.size();
+
+	DiskHeader header;
+	if (size < sizeof(header)) {
+		mapping.close();
+		return;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+		|| sizeof(header) + (uint64_t)header.entryCount * sizeof(DiskEntry) > size) {
+		std::cout << "Ignoring texture cache: " << path << std::endl;
+		mapping.close();
+		return;
+	}
+
+	// Anything that doesn't fit the file or its own dimensions is dropped
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		DiskEntry entry;
+		memcpy(&entry, data + sizeof(header) + i * sizeof(DiskEntry), sizeof(entry));
+
+		if (entry.width <= 0 || entry.height <= 0 || entry.channels < 1 || entry.channels > 4)
+			continue;
+		MipChain layout;
+		if (LayoutMipChain(entry.width, entry.height, entry.channels, layout) != entry.size)
+			continue;
+		if (entry.offset % CACHE_ALIGNMENT != 0 || entry.offset > size || entry.size > size - entry.offset)
+			continue;
+
+		index.push_back(entry);
+	}
+
+	std::cout << "Loaded texture cache: " << path << " (" << index.size() << " entries)" << std::endl;
+}
+
+void TextureCache::write() {
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	if (pending.empty())
+		return;
+
+	// Old entries stay unless this run stored a newer version of them
+	std::vector<PendingEntry> entries;
+	for (const DiskEntry& entry : index) {
+		bool replaced = false;
+		for (const PendingEntry& stored : pending) {
+			if (stored.entry.pathHash == entry.pathHash && stored.entry.flags == entry.flags)
+				replaced = true;
+		}
+		if (!replaced)
+			entries.push_back({ entry, nullptr });
+	}
+	for (const PendingEntry& stored : pending) {
+		bool duplicate = false;
+		for (const PendingEntry& existing : entries) {
+			if (existing.entry.pathHash == stored.entry.pathHash && existing.entry.flags == stored.entry.flags)
+				duplicate = true;
+		}
+		if (!duplicate)
+			entries.push_back(stored);
+	}
+
+	uint64_t offset = AlignUp(sizeof(DiskHeader) + entries.size() * sizeof(DiskEntry));
+	for (PendingEntry& stored : entries) {
+		// Old data is copied out of the mapping, so remember where it came from
+		if (!stored.chain) {
+			std::shared_ptr<MipChain> chain = std::make_shared<MipChain>();
+			LayoutMipChain(stored.entry.width, stored.entry.height, stored.entry.channels, *chain);
+			chain->mapped = mapping.data() + stored.entry.offset;
+			stored.chain = chain;
+		}
+		stored.entry.offset = offset;
+		offset = AlignUp(offset + stored.entry.size);
+	}
+
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "Failed to write texture cache: " << tempPath << std::endl;
+		return;
+	}
+
+	DiskHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	file.write((const char*)&header, sizeof(header));
+	for (const PendingEntry& stored : entries)
+		file.write((const char*)&stored.entry, sizeof(stored.entry));
+
+	static const char padding[CACHE_ALIGNMENT] = {};
+	for (const PendingEntry& stored : entries) {
+		uint64_t position = (uint64_t)file.tellp();
+		file.write(padding, (std::streamsize)(stored.entry.offset - position));
+		file.write((const char*)stored.chain->levelData(0), (std::streamsize)stored.entry.size);
+	}
+	file.close();
+
+	if (!file) {
+		std::cout << "Failed to write texture cache: " << tempPath << std::endl;
+		return;
+	}
+
+	// The old file can only be replaced once nothing maps it
+	entries.clear();
+	mapping.close();
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		std::cout << "Failed to replace texture cache: " << path << " (" << error.message() << ")" << std::endl;
+
+	pending.clear();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mip_chain.h"
+
+// Decode options that change the pixels, part of every cache key
+enum TextureCacheFlags {
+	TEXTURE_CACHE_FLIP_VERTICALLY = 1 << 0,
+	TEXTURE_CACHE_EXPAND_RGB = 1 << 1,
+};
+
+// Keeps decoded mip chains in a single indexed file which later runs memory map,
+// so a warm start hands mapped pages straight to GL without decoding anything.
+// Entries are keyed by source path, size, modification time and decode flags.
+class TextureCache {
+public:
+	TextureCache(const char* cachePath);
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	// Safe to call from any thread. A hit points into the mapping, which stays
+	// valid for as long as the cache is alive.
+	std::shared_ptr<MipChain> find(const char* sourcePath, uint32_t flags) const;
+
+	// Safe to call from any thread. Stored chains are written out when the cache
+	// is destroyed, the mapping can't be replaced while hits are still in use.
+	void store(const char* sourcePath, uint32_t flags, const std::shared_ptr<const MipChain>& chain);
+
+private:
+	struct DiskHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t entryCount;
+	};
+
+	struct DiskEntry {
+		uint64_t pathHash;
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t offset;
+		uint64_t size;
+		uint32_t flags;
+		int32_t width;
+		int32_t height;
+		int32_t channels;
+	};
+
+	struct PendingEntry {
+		DiskEntry entry;
+		std::shared_ptr<const MipChain> chain;
+	};
+
+	static bool makeKey(const char* sourcePath, uint32_t flags, DiskEntry& key);
+	void load();
+	void write();
+
+	std::string path;
+	MappedFile mapping;
+	std::vector<DiskEntry> index;
+
+	std::mutex pendingMutex;
+	std::vector<PendingEntry> pending;
+};
+
+#endif
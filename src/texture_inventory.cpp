@@ -0,0 +1,73 @@
+#include "texture_inventory.h"
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <system_error>
+
+#include "decode_arena.h"
+#include "mapped_file.h"
+#include "mip_chain.h"
+#include "stb_image.h"
+
+static std::string NormalizePath(const std::filesystem::path& path) {
+	return path.lexically_normal().generic_string();
+}
+
+void TextureInventory::scan(const char* directory, ThreadPool& pool) {
+	std::vector<TextureInfo> found;
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+		if (it->is_regular_file(error)) {
+			TextureInfo info;
+			info.path = NormalizePath(it->path());
+			found.push_back(info);
+		}
+	}
+
+	std::vector<char> valid(found.size(), 0);
+	pool.parallelFor((int)found.size(), [&found, &valid](int index) {
+		TextureInfo& info = found[index];
+		MappedFile file;
+		if (!file.open(info.path.c_str()))
+			return;
+
+		// stb_image stops at the header, the rest of the mapping is never touched
+		int length = (int)std::min(file.size(), (size_t)INT_MAX);
+		DecodeArenaScope arena;
+		if (!stbi_info_from_memory(file.data(), length, &info.width, &info.height, &info.channels))
+			return;
+		info.is16Bit = stbi_is_16_bit_from_memory(file.data(), length) != 0;
+
+		MipChain layout;
+		info.chainBytes = LayoutMipChain(info.width, info.height, MipChainChannels(info.channels), layout);
+		valid[index] = 1;
+	});
+
+	entries.clear();
+	for (size_t i = 0; i < found.size(); i++) {
+		if (valid[i])
+			entries.push_back(std::move(found[i]));
+	}
+	std::sort(entries.begin(), entries.end(), [](const TextureInfo& a, const TextureInfo& b) {
+		if (a.chainBytes != b.chainBytes)
+			return a.chainBytes > b.chainBytes;
+		return a.path < b.path;
+	});
+}
+
+const TextureInfo* TextureInventory::find(const char* path) const {
+	std::string normalized = NormalizePath(path);
+	for (const TextureInfo& info : entries) {
+		if (info.path == normalized)
+			return &info;
+	}
+	return nullptr;
+}
+
+size_t TextureInventory::totalBytes() const {
+	size_t total = 0;
+	for (const TextureInfo& info : entries)
+		total += info.chainBytes;
+	return total;
+}
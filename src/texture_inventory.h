@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef TEXTURE_INVENTORY_H
+#define TEXTURE_INVENTORY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+// What an image's header says about it, enough to plan memory before decoding
+struct TextureInfo {
+	std::string path;       // relative to the working directory, forward slashes
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	bool is16Bit = false;   // still streamed at 8 bits per channel
+	size_t chainBytes = 0;  // every mip level as it is uploaded
+};
+
+// Manifest of the images under a directory, built from their headers only.
+// Files are memory mapped, so reading a header only pulls its first pages from disk.
+class TextureInventory {
+public:
+	// Replaces the manifest with every image found under directory, reading headers on the pool.
+	// Files stb_image can't read the header of are left out.
+	void scan(const char* directory, ThreadPool& pool);
+
+	const TextureInfo* find(const char* path) const;
+
+	// Largest mip chain first
+	const std::vector<TextureInfo>& textures() const { return entries; }
+	size_t totalBytes() const;
+
+private:
+	std::vector<TextureInfo> entries;
+};
+
+#endif
@@ -0,0 +1,546 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "stb_image.h"
+
+static GLenum FormatForChannels(int channels) {
+	switch (channels) {
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+static GLint InternalFormatForChannels(int channels) {
+	switch (channels) {
+	case 1: return GL_R8;
+	case 2: return GL_RG8;
+	case 3: return GL_RGB8;
+	default: return GL_RGBA8;
+	}
+}
+
+// stb_image previews are 1/8 scale, standing in for this level and the ones below it
+static const int PREVIEW_LEVEL = 3;
+
+// Lets stb_image spread a single decode over the streaming workers
+static void ParallelForOnPool(void* user, int count, void (*task)(void* taskData, int index), void* taskData) {
+	// Each task's scratch comes out of the arena of whichever thread runs it
+	static_cast<ThreadPool*>(user)->parallelFor(count, [task, taskData](int index) {
+		DecodeArenaScope scope;
+		task(taskData, index);
+	});
+}
+
+TextureStreamer::TextureStreamer(const TextureStreamerConfig& config)
+	: config(config), lastReport(std::chrono::steady_clock::now()), uploads(config.uploadRingBytes), workers(config.workerThreads) {
+}
+
+TextureStreamer::~TextureStreamer() {
+}
+
+void TextureStreamer::scanInventory(const char* directory) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	manifest.scan(directory, workers);
+	double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	for (StreamedTexture& texture : textures)
+		texture.info = manifest.find(texture.path.c_str());
+
+	for (const TextureInfo& info : manifest.textures()) {
+		std::cout << "Texture inventory: " << info.path << " (" << info.width << "x" << info.height << ", "
+			<< info.channels << " channels, " << (info.is16Bit ? 16 : 8) << " bit, " << info.chainBytes / 1024 << " KB of mips)" << std::endl;
+	}
+	std::cout << "Texture inventory: " << manifest.textures().size() << " textures, " << manifest.totalBytes() / 1024
+		<< " KB of mips, headers read in " << elapsed << " ms" << std::endl;
+}
+
+void TextureStreamer::stream(unsigned int texture, const char* path) {
+	StreamedTexture streamed;
+	streamed.id = texture;
+	streamed.path = path;
+	streamed.info = manifest.find(path);
+
+	// A texture that can never be fully resident is turned away before any decoding
+	if (streamed.info && streamed.info->chainBytes > config.vramBudget) {
+		std::cout << "Rejected texture: " << path << " (" << streamed.info->chainBytes / 1024 << " KB of mips, budget is "
+			<< config.vramBudget / 1024 << " KB)" << std::endl;
+		streamed.failed = true;
+		textures.push_back(streamed);
+		return;
+	}
+
+	if (streamed.info)
+		reserveStorage(streamed);
+	textures.push_back(streamed);
+	queuedDecodes.push_back({ texture, path, streamed.info ? streamed.info->chainBytes : 0 });
+}
+
+void TextureStreamer::reportFootprint(unsigned int texture, float pixels) {
+	StreamedTexture* streamed = find(texture);
+	if (streamed)
+		streamed->footprint = std::max(streamed->footprint, pixels);
+}
+
+void TextureStreamer::setBudget(size_t bytes) {
+	config.vramBudget = bytes;
+}
+
+void TextureStreamer::update() {
+	submitDecodes();
+	collectResults();
+	updateResidency();
+	updateStats();
+}
+
+void TextureStreamer::submitDecodes() {
+	// The largest textures take longest to decode, so they start first rather than finishing last
+	std::stable_sort(queuedDecodes.begin(), queuedDecodes.end(), [](const QueuedDecode& a, const QueuedDecode& b) {
+		return a.bytes > b.bytes;
+	});
+	for (const QueuedDecode& queued : queuedDecodes) {
+		unsigned int id = queued.id;
+		std::string file = queued.path;
+		workers.submit([this, id, file] { decode(id, file); });
+	}
+	queuedDecodes.clear();
+}
+
+void TextureStreamer::decode(unsigned int id, std::string path) {
+	std::shared_ptr<MipChain> chain;
+	DecodeArenaStats scratch;
+	bool previewed = false;
+	uint32_t cacheFlags = TEXTURE_CACHE_FLIP_VERTICALLY | TEXTURE_CACHE_EXPAND_RGB;
+
+	// Cached chains are only mapped here, their pages get touched level by level later
+	if (config.cache)
+		chain = config.cache->find(path.c_str(), cacheFlags);
+
+	if (!chain) {
+		// The header sizes the chain so level 0 can be decoded, flipped, straight into it
+		// stb_image's own allocations are all released when the scope ends
+		int width, height, channels;
+		DecodeArenaScope arena;
+		if (stbi_info(path.c_str(), &width, &height, &channels)) {
+			chain = std::make_shared<MipChain>();
+			AllocateMipChain(width, height, MipChainChannels(channels), *chain);
+			PreviewTarget preview = { this, id, width, height, chain->channels, true, false };
+			stbi_set_preview_callback_thread(deliverPreview, &preview);
+			if (stbi_load_into(path.c_str(), chain->pixels.get(), chain->levels[0].size, width * chain->channels,
+				&width, &height, &channels, chain->channels, preview.flipped, ParallelForOnPool, &workers))
+				BuildMipChain(*chain);
+			else
+				chain.reset();
+			stbi_set_preview_callback_thread(NULL, NULL);
+			previewed = preview.delivered;
+		}
+		scratch = arena.stats();
+
+		if (!chain)
+			std::cout << "Failed to load texture: " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		else if (config.cache)
+			config.cache->store(path.c_str(), cacheFlags, chain);
+	}
+
+	// A texture whose later scans turned out corrupt keeps its preview
+	if (!chain && previewed)
+		return;
+
+	int readyLevel = chain && chain->mapped ? (int)chain->levels.size() : 0;
+	std::lock_guard<std::mutex> lock(resultsMutex);
+	results.push_back({ id, chain, readyLevel, scratch });
+}
+
+void TextureStreamer::deliverPreview(void* user, const unsigned char* pixels, int width, int height, int channels) {
+	PreviewTarget& target = *static_cast<PreviewTarget*>(user);
+	std::shared_ptr<MipChain> chain = std::make_shared<MipChain>();
+	LayoutMipChain(target.width, target.height, target.channels, *chain);
+	if ((int)chain->levels.size() <= PREVIEW_LEVEL || channels != target.channels)
+		return;
+
+	// Level sizes round down where the preview's round up, so its partial last block row
+	// and column can go. Flipped, that row comes first.
+	AllocateMipChain(target.width, target.height, target.channels, *chain, PREVIEW_LEVEL);
+	const MipLevel& level = chain->levels[PREVIEW_LEVEL];
+	const unsigned char* source = pixels + (target.flipped ? (size_t)(height - level.height) * width * channels : 0);
+	for (int y = 0; y < level.height; y++)
+		memcpy(chain->pixels.get() + (size_t)y * level.width * channels, source + (size_t)y * width * channels, (size_t)level.width * channels);
+	BuildMipChain(*chain);
+
+	std::lock_guard<std::mutex> lock(target.streamer->resultsMutex);
+	target.streamer->results.push_back({ target.id, chain, PREVIEW_LEVEL });
+	target.delivered = true;
+}
+
+void TextureStreamer::prefetch(StreamedTexture& texture) {
+	if (texture.prefetching)
+		return;
+	texture.prefetching = true;
+	texture.prefetchTarget = texture.wantedBase;
+
+	unsigned int id = texture.id;
+	std::shared_ptr<MipChain> chain = texture.chain;
+	int from = texture.readyBase;
+	int to = texture.wantedBase;
+	workers.submit([this, id, chain, from, to] {
+		for (int level = from - 1; level >= to; level--) {
+			// Reading a byte per page is enough to fault the level in off the GL thread
+			const unsigned char* data = chain->levelData(level);
+			size_t size = chain->levels[level].size;
+			volatile unsigned char sink = 0;
+			for (size_t offset = 0; offset < size; offset += 4096)
+				sink += data[offset];
+			sink += data[size - 1];
+
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			results.push_back({ id, nullptr, level });
+		}
+	});
+}
+
+void TextureStreamer::collectResults() {
+	std::vector<WorkerResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		finished.swap(results);
+	}
+
+	for (WorkerResult& result : finished) {
+		StreamedTexture* texture = find(result.id);
+		if (!texture)
+			continue;
+
+		if (texture->chain && !result.chain) {
+			texture->readyBase = std::min(texture->readyBase, result.readyLevel);
+			if (texture->readyBase <= texture->prefetchTarget)
+				texture->prefetching = false;
+			continue;
+		}
+
+		if (!result.chain) {
+			releaseStorage(*texture);
+			texture->failed = true;
+			continue;
+		}
+
+		const MipChain& chain = *result.chain;
+		if (texture->chain) {
+			// The full decode after a preview, levels uploaded from the preview are refined in place
+			texture->chain = result.chain;
+			texture->readyBase = result.readyLevel;
+			for (int level = texture->residentBase; level < texture->levelCount; level++)
+				transfer(*texture, level);
+		}
+		else {
+			// The file can change between the inventory scan and the decode
+			const TextureInfo* info = texture->info;
+			if (texture->reservedBytes > 0 && (info->width != chain.width || info->height != chain.height || MipChainChannels(info->channels) != chain.channels))
+				releaseStorage(*texture);
+
+			texture->chain = result.chain;
+			texture->levelCount = (int)chain.levels.size();
+			texture->residentBase = texture->levelCount;
+			texture->readyBase = result.readyLevel;
+			if (texture->reservedBytes == 0)
+				texture->storageBase = texture->levelCount;
+
+			glBindTexture(GL_TEXTURE_2D, texture->id);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->levelCount - 1);
+		}
+
+		if (chain.firstLevel > 0) {
+			std::cout << "Streaming preview: " << texture->path << " (" << chain.levels[chain.firstLevel].width << "x"
+				<< chain.levels[chain.firstLevel].height << " until the full decode)" << std::endl;
+			continue;
+		}
+		std::cout << (chain.mapped ? "Streaming cached texture: " : "Streaming texture: ") << texture->path
+			<< " (" << chain.width << "x" << chain.height << ", " << texture->levelCount << " mips";
+		if (!chain.mapped)
+			std::cout << ", " << result.scratch.peakBytes / 1024 << " KB scratch in " << result.scratch.allocations << " allocations";
+		std::cout << ")" << std::endl;
+	}
+}
+
+int TextureStreamer::wantedLevel(const StreamedTexture& texture) const {
+	int coarsest = texture.levelCount - 1;
+	if (texture.lastFootprint <= 0.0f)
+		return coarsest;
+
+	float texels = (float)std::max(texture.chain->width, texture.chain->height);
+	float level = std::log2(texels / texture.lastFootprint) + config.lodBias;
+	if (level <= 0.0f)
+		return 0;
+	return std::min((int)level, coarsest);
+}
+
+void TextureStreamer::updateResidency() {
+	std::vector<StreamedTexture*> pending;
+	for (StreamedTexture& texture : textures) {
+		// Feedback from last frame drives this frame's residency
+		texture.lastFootprint = texture.footprint;
+		texture.footprint = 0.0f;
+
+		if (!texture.chain)
+			continue;
+
+		texture.wantedBase = wantedLevel(texture);
+		if (texture.residentBase > texture.wantedBase)
+			pending.push_back(&texture);
+
+		if (texture.minLod > 0.0f) {
+			texture.minLod = std::max(0.0f, texture.minLod - 1.0f / std::max(1, config.lodFadeFrames));
+			applyLodClamp(texture);
+		}
+	}
+
+	// Budget can shrink at runtime, give back reservations and then whatever no longer fits
+	for (StreamedTexture& texture : textures) {
+		if (currentStats.residentBytes + currentStats.reservedBytes <= config.vramBudget)
+			break;
+		releaseStorage(texture);
+	}
+	while (currentStats.residentBytes + currentStats.reservedBytes > config.vramBudget) {
+		StreamedTexture* victim = findVictim(nullptr, false);
+		if (!victim)
+			break;
+		evict(*victim);
+	}
+
+	// Textures that are furthest from the detail they need go first
+	std::sort(pending.begin(), pending.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+		int aMissing = a->residentBase - a->wantedBase;
+		int bMissing = b->residentBase - b->wantedBase;
+		if (aMissing != bMissing)
+			return aMissing > bMissing;
+		return a->lastFootprint > b->lastFootprint;
+	});
+
+	size_t uploaded = 0;
+	for (StreamedTexture* texture : pending) {
+		while (texture->residentBase > texture->wantedBase) {
+			int level = texture->residentBase - 1;
+			size_t bytes = texture->chain->levels[level].size;
+
+			// Mapped levels are paged in by a worker before the GL thread reads them,
+			// previews wait for the full decode
+			if (level < texture->readyBase) {
+				if (texture->chain->mapped)
+					prefetch(*texture);
+				break;
+			}
+
+			// Always let one level through so huge mips can't stall forever
+			if (uploaded > 0 && uploaded + bytes > config.uploadBytesPerFrame)
+				return;
+			// Reserved levels are already counted against the budget
+			if (!makeRoom(level >= texture->storageBase ? 0 : bytes, texture))
+				break;
+
+			upload(*texture, level);
+			uploaded += bytes;
+		}
+	}
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, const StreamedTexture* requester) {
+	while (currentStats.residentBytes + currentStats.reservedBytes + bytes > config.vramBudget) {
+		StreamedTexture* victim = findVictim(requester, true);
+		if (!victim)
+			return false;
+		evict(*victim);
+	}
+	return true;
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::findVictim(const StreamedTexture* requester, bool surplusOnly) {
+	// Prefer levels nobody is looking at, then textures covering less of the screen.
+	// The coarsest level always stays resident so every texture remains complete.
+	StreamedTexture* best = nullptr;
+	for (StreamedTexture& texture : textures) {
+		if (&texture == requester || !texture.chain || texture.residentBase >= texture.levelCount - 1)
+			continue;
+
+		bool surplus = texture.residentBase < texture.wantedBase;
+		if (surplusOnly && !surplus && (!requester || texture.lastFootprint >= requester->lastFootprint))
+			continue;
+
+		if (!best) {
+			best = &texture;
+			continue;
+		}
+
+		bool bestSurplus = best->residentBase < best->wantedBase;
+		if (surplus != bestSurplus) {
+			if (surplus)
+				best = &texture;
+		}
+		else if (texture.lastFootprint < best->lastFootprint) {
+			best = &texture;
+		}
+	}
+	return best;
+}
+
+void TextureStreamer::upload(StreamedTexture& texture, int level) {
+	const MipLevel& mip = texture.chain->levels[level];
+
+	// Filling in a reserved level turns its bytes from reserved into resident ones
+	if (level >= texture.storageBase) {
+		texture.reservedBytes -= mip.size;
+		currentStats.reservedBytes -= mip.size;
+	}
+	transfer(texture, level);
+
+	// Fade the new level in rather than popping, unless it is the first one
+	bool hadLevels = texture.residentBase < texture.levelCount;
+	texture.residentBase = level;
+	texture.minLod = hadLevels ? 1.0f : 0.0f;
+	applyLodClamp(texture);
+
+	currentStats.residentBytes += mip.size;
+}
+
+void TextureStreamer::transfer(StreamedTexture& texture, int level) {
+	const MipChain& chain = *texture.chain;
+	const MipLevel& mip = chain.levels[level];
+
+	// Staged levels are read from the ring by the GPU later instead of copied inside glTexImage2D.
+	// Levels too big for the ring go straight from client memory.
+	const void* pixels = chain.levelData(level);
+	bool staged = false;
+	if (unsigned char* staging = uploads.map(mip.size)) {
+		memcpy(staging, pixels, mip.size);
+		staged = uploads.unmap();
+	}
+	if (staged)
+		pixels = uploads.offset();
+
+	// Levels with storage already are only filled in, others are specified as they arrive
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (level >= texture.storageBase) {
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mip.width, mip.height, FormatForChannels(chain.channels), GL_UNSIGNED_BYTE, pixels);
+	}
+	else {
+		glTexImage2D(GL_TEXTURE_2D, level, InternalFormatForChannels(chain.channels), mip.width, mip.height, 0,
+			FormatForChannels(chain.channels), GL_UNSIGNED_BYTE, pixels);
+		texture.storageBase = level;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (staged)
+		uploads.submit();
+	currentStats.uploadStalls = uploads.stalls();
+
+	currentStats.totalBytesStreamed += mip.size;
+	bytesSinceReport += mip.size;
+}
+
+void TextureStreamer::evict(StreamedTexture& texture) {
+	// Storage below the evicted level would be left reserved with nothing to account for it
+	releaseStorage(texture);
+
+	int level = texture.residentBase;
+	const MipLevel& mip = texture.chain->levels[level];
+
+	// Clamp first so the texture stays complete, then respecify the level as empty to free it
+	texture.residentBase = level + 1;
+	texture.minLod = 0.0f;
+	applyLodClamp(texture);
+	glTexImage2D(GL_TEXTURE_2D, level, InternalFormatForChannels(texture.chain->channels), 0, 0, 0,
+		FormatForChannels(texture.chain->channels), GL_UNSIGNED_BYTE, NULL);
+
+	texture.storageBase = level + 1;
+
+	currentStats.residentBytes -= mip.size;
+	currentStats.evictions++;
+}
+
+void TextureStreamer::reserveStorage(StreamedTexture& texture) {
+	const TextureInfo& info = *texture.info;
+	if (currentStats.residentBytes + currentStats.reservedBytes + info.chainBytes > config.vramBudget)
+		return;
+
+	// GL 3.3 has no glTexStorage2D, so every level is specified empty instead. Unlike immutable
+	// storage, levels can still be freed one at a time when they are evicted.
+	MipChain layout;
+	LayoutMipChain(info.width, info.height, MipChainChannels(info.channels), layout);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	for (size_t level = 0; level < layout.levels.size(); level++) {
+		glTexImage2D(GL_TEXTURE_2D, (GLint)level, InternalFormatForChannels(layout.channels), layout.levels[level].width, layout.levels[level].height, 0,
+			FormatForChannels(layout.channels), GL_UNSIGNED_BYTE, NULL);
+	}
+
+	// Base past max leaves the texture incomplete, so nothing samples it before the first upload
+	texture.levelCount = (int)layout.levels.size();
+	texture.residentBase = texture.levelCount;
+	texture.storageBase = 0;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.levelCount);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levelCount - 1);
+
+	texture.reservedBytes = info.chainBytes;
+	currentStats.reservedBytes += info.chainBytes;
+}
+
+void TextureStreamer::releaseStorage(StreamedTexture& texture) {
+	if (texture.reservedBytes == 0)
+		return;
+
+	// Reserved levels are the ones nothing was uploaded into yet
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	for (int level = texture.storageBase; level < texture.residentBase; level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, InternalFormatForChannels(MipChainChannels(texture.info->channels)), 0, 0, 0,
+			FormatForChannels(MipChainChannels(texture.info->channels)), GL_UNSIGNED_BYTE, NULL);
+	}
+	texture.storageBase = texture.residentBase;
+
+	currentStats.reservedBytes -= texture.reservedBytes;
+	texture.reservedBytes = 0;
+}
+
+void TextureStreamer::applyLodClamp(StreamedTexture& texture) {
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.residentBase);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, texture.minLod);
+}
+
+void TextureStreamer::updateStats() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - lastReport).count();
+	if (elapsed < 1.0)
+		return;
+
+	currentStats.bytesStreamedPerSecond = bytesSinceReport / elapsed;
+	if (bytesSinceReport > 0) {
+		std::cout << "Texture streaming: " << currentStats.bytesStreamedPerSecond / 1024.0 << " KB/s, "
+			<< currentStats.residentBytes / 1024 << " KB of " << config.vramBudget / 1024 << " KB resident, "
+			<< currentStats.reservedBytes / 1024 << " KB reserved, "
+			<< currentStats.evictions << " evictions, " << currentStats.uploadStalls << " upload stalls" << std::endl;
+	}
+
+	bytesSinceReport = 0;
+	lastReport = now;
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::find(unsigned int id) {
+	for (StreamedTexture& texture : textures) {
+		if (texture.id == id)
+			return &texture;
+	}
+	return nullptr;
+}
+
+float ScreenFootprint(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& center, float radius, int viewportHeight) {
+	glm::vec4 viewPosition = view * glm::vec4(center, 1.0f);
+	float depth = -viewPosition.z;
+	if (depth <= radius)
+		return (float)viewportHeight;
+
+	// projection[1][1] is cot(fov / 2), which maps view space height to NDC
+	return 2.0f * radius * projection[1][1] / depth * 0.5f * viewportHeight;
+}
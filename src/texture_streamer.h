@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "decode_arena.h"
+#include "mip_chain.h"
+#include "texture_cache.h"
+#include "texture_inventory.h"
+#include "thread_pool.h"
+#include "upload_ring.h"
+
+struct TextureStreamerConfig {
+	size_t vramBudget = 64 * 1024 * 1024;     // bytes of mip data allowed on the GPU
+	size_t uploadBytesPerFrame = 1024 * 1024; // upload bandwidth spent per frame
+	size_t uploadRingBytes = 4 * 1024 * 1024; // staging memory for asynchronous uploads
+	unsigned int workerThreads = 2;           // also shared by the parts of a single JPEG decode
+	float lodBias = 0.0f;                     // positive values stream less detail
+	int lodFadeFrames = 8;                    // frames a new level takes to fade in
+	TextureCache* cache = nullptr;            // decoded chains are read from and stored here
+};
+
+struct TextureStreamerStats {
+	size_t residentBytes = 0;
+	size_t reservedBytes = 0;                // storage allocated ahead of the levels uploaded into it
+	size_t totalBytesStreamed = 0;
+	double bytesStreamedPerSecond = 0.0;
+	unsigned int evictions = 0;
+	unsigned int uploadStalls = 0;           // uploads that waited for the GPU to free staging memory
+};
+
+// Streams textures into GL mip by mip, smallest first. Decoding, mip
+// generation and paging in cached levels happen on worker threads, uploads
+// happen in update() on the GL thread through a pixel buffer ring. Which
+// levels are resident follows the screen space footprint each texture was
+// drawn at, within a fixed VRAM budget. Textures found by an inventory scan
+// are checked against the budget and get their storage before decoding.
+// Progressive JPEGs show a 1/8 scale preview while the rest of their scans
+// decode.
+class TextureStreamer {
+public:
+	TextureStreamer(const TextureStreamerConfig& config);
+	~TextureStreamer();
+
+	// Reads the header of every image under directory. Call before streaming them.
+	void scanInventory(const char* directory);
+	const TextureInventory& inventory() const { return manifest; }
+
+	// Queue an image for streaming into an already generated 2D texture.
+	// Decodes start on the next update(), largest known texture first.
+	// Binds GL_TEXTURE_2D of the active unit when the inventory knows the image.
+	void stream(unsigned int texture, const char* path);
+
+	// Size in pixels the texture covered on screen this frame.
+	// The largest footprint reported during a frame is the one used.
+	void reportFootprint(unsigned int texture, float pixels);
+
+	// Once per frame on the GL thread, binds GL_TEXTURE_2D of the active unit
+	void update();
+
+	void setBudget(size_t bytes);
+	const TextureStreamerStats& stats() const { return currentStats; }
+
+private:
+	struct StreamedTexture {
+		unsigned int id;
+		std::string path;
+		std::shared_ptr<MipChain> chain;
+		const TextureInfo* info = nullptr; // header from the inventory, if it was scanned
+		bool failed = false;
+		int levelCount = 0;
+		int residentBase = 0; // finest resident level, levelCount when nothing is resident
+		int readyBase = 0;    // finest level whose pages are in memory
+		int storageBase = 0;  // finest level with GL storage, levelCount when none has
+		size_t reservedBytes = 0;
+		int wantedBase = 0;
+		int prefetchTarget = 0;
+		bool prefetching = false;
+		float footprint = 0.0f;
+		float lastFootprint = 0.0f;
+		float minLod = 0.0f;
+	};
+
+	struct WorkerResult {
+		unsigned int id;
+		std::shared_ptr<MipChain> chain; // set once a decode or cache lookup finishes
+		int readyLevel;                  // finest level paged in so far
+		DecodeArenaStats scratch;        // decoder memory on the worker thread, not its tasks
+	};
+
+	struct QueuedDecode {
+		unsigned int id;
+		std::string path;
+		size_t bytes; // mip chain size from the inventory, 0 when unknown
+	};
+
+	// Where a decode on a worker sends its preview
+	struct PreviewTarget {
+		TextureStreamer* streamer;
+		unsigned int id;
+		int width;
+		int height;
+		int channels;
+		bool flipped;      // rows bottom-up, like the load it previews
+		bool delivered;
+	};
+
+	void submitDecodes();
+	void decode(unsigned int id, std::string path);
+	static void deliverPreview(void* user, const unsigned char* pixels, int width, int height, int channels);
+	void prefetch(StreamedTexture& texture);
+	void collectResults();
+	void updateResidency();
+	void updateStats();
+
+	int wantedLevel(const StreamedTexture& texture) const;
+	bool makeRoom(size_t bytes, const StreamedTexture* requester);
+	StreamedTexture* findVictim(const StreamedTexture* requester, bool surplusOnly);
+	void upload(StreamedTexture& texture, int level);
+	void transfer(StreamedTexture& texture, int level);
+	void evict(StreamedTexture& texture);
+	void reserveStorage(StreamedTexture& texture);
+	void releaseStorage(StreamedTexture& texture);
+	void applyLodClamp(StreamedTexture& texture);
+	StreamedTexture* find(unsigned int id);
+
+	TextureStreamerConfig config;
+	std::vector<StreamedTexture> textures;
+	std::vector<QueuedDecode> queuedDecodes;
+	TextureInventory manifest;
+
+	std::mutex resultsMutex;
+	std::vector<WorkerResult> results;
+
+	TextureStreamerStats currentStats;
+	size_t bytesSinceReport = 0;
+	std::chrono::steady_clock::time_point lastReport;
+
+	UploadRing uploads;
+
+	// Declared last so the workers stop before anything they touch is destroyed
+	ThreadPool workers;
+};
+
+// Approximate on screen diameter in pixels of a sphere around a world space point
+float ScreenFootprint(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& center, float radius, int viewportHeight);
+
+#endif
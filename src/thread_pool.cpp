@@ -0,0 +1,83 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+	if (threadCount == 0)
+		threadCount = 1;
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobsChanged.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs.push_back(std::move(job));
+	}
+	jobsChanged.notify_one();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& fn) {
+	struct Loop {
+		std::atomic<int> next{ 0 };
+		int done = 0;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	// Helpers can start after the loop is over, so they share ownership of its state
+	// and only touch fn while indices are left, which keeps the caller waiting
+	std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+	const std::function<void(int)>* body = &fn;
+	auto run = [loop, body, count] {
+		int ran = 0;
+		for (int i = loop->next++; i < count; i = loop->next++) {
+			(*body)(i);
+			ran++;
+		}
+		if (ran == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(loop->mutex);
+		loop->done += ran;
+		if (loop->done == count)
+			loop->finished.notify_all();
+	};
+
+	unsigned int helpers = std::min((unsigned int)std::max(count - 1, 0), threadCount());
+	for (unsigned int i = 0; i < helpers; i++)
+		submit(run);
+	run();
+
+	std::unique_lock<std::mutex> lock(loop->mutex);
+	loop->finished.wait(lock, [&] { return loop->done == count; });
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobsChanged.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
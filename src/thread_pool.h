@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off a shared queue.
+// Jobs that have not started when the pool is destroyed are dropped.
+class ThreadPool {
+public:
+	ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// Calls fn(i) for every i in [0, count) and returns once all calls are done.
+	// The calling thread takes indices too, so this is safe to use from inside a job.
+	void parallelFor(int count, const std::function<void(int)>& fn);
+
+	unsigned int threadCount() const { return (unsigned int)workers.size(); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobsChanged;
+	bool stopping = false;
+};
+
+#endif
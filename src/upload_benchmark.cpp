@@ -0,0 +1,85 @@
+#include "upload_benchmark.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "upload_ring.h"
+
+// Each upload is repeated this many times, the best run is reported
+static const int UPLOAD_RUNS = 10;
+
+// Odd sizes have rows that aren't 4-byte aligned in RGB
+static const int UPLOAD_SIZES[] = { 2048, 1023, 512 };
+
+struct UploadFormat {
+	const char* name;
+	GLint internalFormat;
+	GLenum format;
+	int channels;
+};
+
+static const UploadFormat UPLOAD_FORMATS[] = {
+	{ "RGB8 from RGB", GL_RGB8, GL_RGB, 3 },
+	{ "RGBA8 from RGBA", GL_RGBA8, GL_RGBA, 4 },
+	{ "RGBA8 from BGRA", GL_RGBA8, GL_BGRA, 4 },
+};
+
+// Best glTexSubImage2D plus glFinish, in seconds. With a ring the pixels are copied
+// into it first, as TextureStreamer::transfer does.
+static double BestUploadSeconds(const UploadFormat& format, int size, const std::vector<unsigned char>& pixels, UploadRing* ring) {
+	double best = 0.0;
+	for (int run = 0; run < UPLOAD_RUNS; run++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const void* source = pixels.data();
+		if (ring) {
+			unsigned char* staging = ring->map(pixels.size());
+			if (staging) {
+				memcpy(staging, pixels.data(), pixels.size());
+				if (ring->unmap())
+					source = ring->offset();
+			}
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, format.format, GL_UNSIGNED_BYTE, source);
+		if (ring && source != pixels.data())
+			ring->submit();
+		glFinish();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = run == 0 ? seconds : std::min(best, seconds);
+	}
+	return best;
+}
+
+void RunUploadBenchmark() {
+	std::cout << "Upload benchmark: " << glGetString(GL_RENDERER) << std::endl;
+	size_t largest = (size_t)UPLOAD_SIZES[0] * UPLOAD_SIZES[0] * 4;
+	UploadRing ring(largest * 2);
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int size : UPLOAD_SIZES) {
+		for (const UploadFormat& format : UPLOAD_FORMATS) {
+			std::vector<unsigned char> pixels((size_t)size * size * format.channels);
+			for (size_t i = 0; i < pixels.size(); i++)
+				pixels[i] = (unsigned char)(i * 7 + i / 4096);
+
+			// Storage first, so only the transfer is timed
+			glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, size, size, 0, format.format, GL_UNSIGNED_BYTE, NULL);
+			double direct = BestUploadSeconds(format, size, pixels, nullptr);
+			double staged = BestUploadSeconds(format, size, pixels, &ring);
+			double megabytes = pixels.size() / (1024.0 * 1024.0);
+			std::cout << "Upload benchmark: " << size << "x" << size << " " << format.name << " " << direct * 1000.0 << " ms ("
+				<< megabytes / direct << " MB/s), staged " << staged * 1000.0 << " ms (" << megabytes / staged << " MB/s)" << std::endl;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(1, &texture);
+	ring.release();
+}
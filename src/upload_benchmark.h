@@ -0,0 +1,11 @@
+#pragma once
+
+#ifndef UPLOAD_BENCHMARK_H
+#define UPLOAD_BENCHMARK_H
+
+// Times filling RGB8 and RGBA8 textures the way the streamer does, from client memory
+// and staged through an UploadRing, with glFinish so the driver's conversion is counted.
+// Needs a current GL context.
+void RunUploadBenchmark();
+
+#endif
@@ -0,0 +1,73 @@
+#include "upload_ring.h"
+
+#include <algorithm>
+
+UploadRing::UploadRing(size_t capacity) : capacity(capacity) {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+unsigned char* UploadRing::map(size_t size) {
+	// Offsets stay aligned for any unpack alignment
+	size = (size + 15) & ~(size_t)15;
+	if (size == 0 || size > capacity)
+		return nullptr;
+	if (head + size > capacity)
+		head = 0;
+
+	// Fences signal in order, so waiting on the oldest region until none overlap is enough
+	size_t begin = head, end = head + size;
+	while (std::any_of(inFlight.begin(), inFlight.end(), [begin, end](const Region& region) {
+		return region.begin < end && begin < region.end;
+	}))
+		waitOldest();
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	void* data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, begin, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!data) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return nullptr;
+	}
+
+	mappedOffset = begin;
+	mappedSize = size;
+	return (unsigned char*)data;
+}
+
+bool UploadRing::unmap() {
+	if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
+		return true;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return false;
+}
+
+void UploadRing::submit() {
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	inFlight.push_back({ mappedOffset, mappedOffset + mappedSize, fence });
+	head = mappedOffset + mappedSize;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void UploadRing::release() {
+	for (const Region& region : inFlight)
+		glDeleteSync(region.fence);
+	inFlight.clear();
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void UploadRing::waitOldest() {
+	Region& oldest = inFlight.front();
+	GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		stallCount++;
+		// Flushing makes sure the fence gets to the GPU and can signal at all
+		while (glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+	}
+	glDeleteSync(oldest.fence);
+	inFlight.pop_front();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <deque>
+
+// Staging memory for texture uploads in a GL_PIXEL_UNPACK_BUFFER used as a ring.
+// Pixels written into mapped ring memory are sourced from the buffer by glTexImage2D,
+// so the transfer to the GPU is queued rather than copied inside the call. Fences
+// keep the ring from overwriting memory the GPU has not read yet.
+// The buffer and fences go away with the GL context rather than in a destructor,
+// which would run after the context is gone. Owners that outlive their ring while
+// the context is still current, like a per asset texture, release() it first.
+class UploadRing {
+public:
+	UploadRing(size_t capacity);
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	// Maps size bytes for writing and binds the buffer, nullptr when it can't take them
+	unsigned char* map(size_t size);
+
+	// Returns false and unbinds the buffer if the mapped contents were lost
+	bool unmap();
+
+	// Pixel pointer to hand to GL for the last mapping
+	const void* offset() const { return (const void*)mappedOffset; }
+
+	// After the GL calls reading the last mapping, fences it and unbinds the buffer
+	void submit();
+
+	// Deletes the buffer and fences, the GL driver keeps the memory until pending
+	// uploads from it are done. The ring can't be used afterwards.
+	void release();
+
+	// Times map() had to wait for the GPU to free ring memory
+	unsigned int stalls() const { return stallCount; }
+
+private:
+	struct Region {
+		size_t begin;
+		size_t end;
+		GLsync fence;
+	};
+
+	void waitOldest();
+
+	GLuint buffer = 0;
+	size_t capacity;
+	size_t head = 0;
+	size_t mappedOffset = 0;
+	size_t mappedSize = 0;
+	std::deque<Region> inFlight;
+	unsigned int stallCount = 0;
+};
+
+#endif
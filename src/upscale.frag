@@ -0,0 +1,34 @@
+#version 330 core
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform vec2 texelSize;    // of the scene texture
+uniform vec2 sceneExtent;  // part of the texture the scene was drawn into
+uniform float sharpness;   // 0 is plain bilinear
+
+vec3 sampleScene(vec2 uv) {
+	// Half a texel in from the edge of the drawn part, so nothing outside it bleeds in
+	return texture(scene, clamp(uv, 0.5 * texelSize, sceneExtent - 0.5 * texelSize)).rgb;
+}
+
+void main() {
+	vec2 uv = texCoord * sceneExtent;
+	vec3 center = sampleScene(uv);
+	if (sharpness <= 0.0) {
+		FragColor = vec4(center, 1.0);
+		return;
+	}
+
+	// Unsharp mask against the four neighbours in scene texels, limited to the
+	// neighbourhood so edges do not ring
+	vec3 north = sampleScene(uv + vec2(0.0, texelSize.y));
+	vec3 south = sampleScene(uv - vec2(0.0, texelSize.y));
+	vec3 east = sampleScene(uv + vec2(texelSize.x, 0.0));
+	vec3 west = sampleScene(uv - vec2(texelSize.x, 0.0));
+	vec3 sharpened = center + sharpness * (4.0 * center - north - south - east - west);
+	vec3 low = min(center, min(min(north, south), min(east, west)));
+	vec3 high = max(center, max(max(north, south), max(east, west)));
+	FragColor = vec4(clamp(sharpened, low, high), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+
+// A triangle covering the screen, no vertex buffer needed
+out vec2 texCoord;
+
+void main() {
+    vec2 corner = vec2((gl_VertexID & 1) * 2, (gl_VertexID & 2));
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    texCoord = corner;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+// Checks stb_image's SSE2 and AVX2 channel conversion against the per-pixel loops and
+// times both. Not part of the app, build it on its own:
+//
+//   g++ -std=c++17 -O2 tools/convert_check.cpp -o convert_check
+//   ./convert_check
+//
+// Random images of every size up to a few hundred pixels go through every channel
+// count pair at 8 and 16 bits. The output is allocated to its exact size, so build
+// with -fsanitize=address to catch writes past it. Exits with 1 if any level differs
+// from plain C by a single bit. Upload times are --benchmark-upload in the app.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Random images checked per channel pair and depth
+static const int IMAGE_TRIALS = 100;
+static const int MAX_TRIAL_WIDTH = 300;
+static const int MAX_TRIAL_HEIGHT = 4;
+
+// Timed images are this size, best of this many runs
+static const int TIMING_SIZE = 4096;
+static const int TIMING_RUNS = 5;
+
+static const char* LEVEL_NAMES[] = { "c", "sse2", "avx2" };
+
+// Levels stbi__convert_format can pick on this CPU
+static int SimdLevels() {
+	int levels = 1;
+#ifdef STBI_SSE2
+	if (stbi__sse2_available())
+		levels = 2;
+#endif
+#ifdef STBI_AVX2
+	if (levels == 2 && stbi__avx2_available())
+		levels = 3;
+#endif
+	return levels;
+}
+
+// The conversion frees its input, so each call gets its own copy
+static void* Convert(const std::vector<stbi_uc>& image, int depth, int imgN, int reqComp, int x, int y, int level) {
+	void* copy = stbi__malloc(image.size());
+	memcpy(copy, image.data(), image.size());
+	if (depth == 16)
+		return stbi__convert_format16_level((stbi__uint16*)copy, imgN, reqComp, x, y, level);
+	return stbi__convert_format_level((stbi_uc*)copy, imgN, reqComp, x, y, level);
+}
+
+static bool CheckImages(int levels, std::mt19937& random, int* checked) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> width(1, MAX_TRIAL_WIDTH);
+	std::uniform_int_distribution<int> height(1, MAX_TRIAL_HEIGHT);
+	bool same = true;
+	for (int depth = 8; depth <= 16; depth += 8) {
+		for (int imgN = 1; imgN <= 4; imgN++) {
+			for (int reqComp = 1; reqComp <= 4; reqComp++) {
+				if (imgN == reqComp)
+					continue;
+				for (int trial = 0; trial < IMAGE_TRIALS; trial++) {
+					int x = width(random), y = height(random);
+					std::vector<stbi_uc> image((size_t)x * y * imgN * (depth / 8));
+					for (stbi_uc& b : image)
+						b = (stbi_uc)byte(random);
+					size_t bytes = (size_t)x * y * reqComp * (depth / 8);
+					void* expected = Convert(image, depth, imgN, reqComp, x, y, 0);
+					for (int level = 1; level < levels; level++) {
+						void* out = Convert(image, depth, imgN, reqComp, x, y, level);
+						if (!expected || !out || memcmp(out, expected, bytes) != 0) {
+							std::cout << "Convert: " << LEVEL_NAMES[level] << " differs from c for " << imgN << " to " << reqComp
+								<< " channels, " << depth << " bit, " << x << "x" << y << std::endl;
+							same = false;
+						}
+						STBI_FREE(out);
+					}
+					STBI_FREE(expected);
+					(*checked)++;
+				}
+			}
+		}
+	}
+	return same;
+}
+
+static void TimeConversions(int levels, std::mt19937& random) {
+	struct Pair {
+		int imgN, reqComp, depth;
+	};
+	const Pair pairs[] = { { 3, 4, 8 }, { 4, 3, 8 }, { 1, 4, 8 }, { 1, 2, 8 }, { 2, 4, 8 }, { 3, 4, 16 }, { 4, 3, 16 } };
+	std::uniform_int_distribution<int> byte(0, 255);
+	for (const Pair& pair : pairs) {
+		std::vector<stbi_uc> image((size_t)TIMING_SIZE * TIMING_SIZE * pair.imgN * (pair.depth / 8));
+		for (stbi_uc& b : image)
+			b = (stbi_uc)byte(random);
+		std::cout << "Convert: " << TIMING_SIZE << "x" << TIMING_SIZE << " " << pair.imgN << " to " << pair.reqComp
+			<< " channels, " << pair.depth << " bit, ms";
+		for (int level = 0; level < levels; level++) {
+			double best = 0.0;
+			for (int run = 0; run < TIMING_RUNS; run++) {
+				void* copy = stbi__malloc(image.size());
+				memcpy(copy, image.data(), image.size());
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				void* out = pair.depth == 16
+					? (void*)stbi__convert_format16_level((stbi__uint16*)copy, pair.imgN, pair.reqComp, TIMING_SIZE, TIMING_SIZE, level)
+					: (void*)stbi__convert_format_level((stbi_uc*)copy, pair.imgN, pair.reqComp, TIMING_SIZE, TIMING_SIZE, level);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				STBI_FREE(out);
+				best = run == 0 ? seconds : std::min(best, seconds);
+			}
+			std::cout << " " << LEVEL_NAMES[level] << " " << best * 1000.0;
+		}
+		std::cout << std::endl;
+	}
+}
+
+int main() {
+	int levels = SimdLevels();
+	std::cout << "Levels:";
+	for (int level = 0; level < levels; level++)
+		std::cout << " " << LEVEL_NAMES[level];
+	std::cout << std::endl;
+
+	std::mt19937 random(36);
+	int checked = 0;
+	bool same = CheckImages(levels, random, &checked);
+	std::cout << "Convert: " << checked << " random images over every channel pair at 8 and 16 bits, "
+		<< (same ? "bit-exact" : "MISMATCH") << std::endl;
+
+	TimeConversions(levels, random);
+	return same ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// Checks stb_image's inflate fast loop against its careful one-symbol-at-a-time loop
+// and against zlib, and times both loops. Not part of the app, build it on its own:
+//
+//   g++ -std=c++17 -O2 tools/inflate_check.cpp -lz -o inflate_check
+//   ./inflate_check [image.png ...]
+//
+// zlib compresses generated data at every level and strategy, raw and wrapped, with
+// flushes and parameter changes mixing stored, fixed and dynamic blocks. Each stream
+// must inflate back to its input with both loops, into a buffer of exactly its size.
+// Corrupted and truncated copies must give the same result from both loops without
+// writing past the buffer; build with -fsanitize=address,undefined to check reads too.
+// The IDAT streams of the PNGs (by default the benchmark corpus and awesomeface.png)
+// are inflated with both loops as well. Exits with 1 on any difference.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Generated inputs per level, strategy and wrapper, and corrupted copies of each stream
+static const int STREAMS_PER_SETTING = 16;
+static const int CORRUPTIONS_PER_STREAM = 4;
+
+// Size of the streams timed, and how long each loop is timed for
+static const size_t TIMING_BYTES = 16 * 1024 * 1024;
+static const double TIMING_SECONDS = 0.5;
+
+// Bytes past the end of every output, which neither loop may touch
+static const int GUARD_BYTES = 64;
+
+static const char* defaultImages[] = {
+	"resources/textures/awesomeface.png",
+	"resources/benchmark/palette.png",
+	"resources/benchmark/rgb16.png",
+	"resources/benchmark/rgb8.png",
+	"resources/benchmark/rgba8_interlaced.png",
+};
+
+static const char* STRATEGY_NAMES[] = { "default", "filtered", "huffman", "rle", "fixed" };
+static const int STRATEGIES[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED };
+
+enum class Content {
+	Random,     // incompressible, stored blocks at any level
+	Text,       // a small skewed alphabet, mostly literals
+	Runs,       // long runs of one byte, distance 1 matches
+	Image,      // gradient rows repeating with noise, matches at every distance
+	Mixed,      // all of the above in turns
+};
+
+static const int CONTENT_COUNT = 5;
+
+static void Generate(std::mt19937& random, Content content, size_t size, std::vector<stbi_uc>& out) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	out.resize(size);
+	size_t at = 0;
+	while (at < size) {
+		Content kind = content == Content::Mixed ? (Content)(random() % (CONTENT_COUNT - 1)) : content;
+		size_t span = content == Content::Mixed ? std::min(size - at, (size_t)(random() % 4096 + 1)) : size - at;
+		for (size_t i = 0; i < span; i++, at++) {
+			switch (kind) {
+			case Content::Random:
+				out[at] = (stbi_uc)byte(random);
+				break;
+			case Content::Text: {
+				// Roughly geometric letter frequencies
+				int letter = 0;
+				while (letter < 25 && (random() & 3) != 0)
+					letter++;
+				out[at] = (stbi_uc)('a' + letter);
+				break;
+			}
+			case Content::Runs:
+				out[at] = at && (random() % 64) != 0 ? out[at - 1] : (stbi_uc)byte(random);
+				break;
+			default: {
+				size_t row = 3 * (random() % 8 == 0 ? 97 : 256);
+				out[at] = at >= row && (random() % 8) != 0 ? out[at - row] : (stbi_uc)((at % row) + byte(random) % 4);
+				break;
+			}
+			}
+		}
+	}
+}
+
+// zlib with a flush and a level change now and then, so one stream holds several kinds
+// of block. Raw streams have no header or Adler-32.
+static bool Compress(std::mt19937& random, const std::vector<stbi_uc>& input, int level, int strategy, bool raw, std::vector<stbi_uc>& out) {
+	z_stream stream = {};
+	if (deflateInit2(&stream, level, Z_DEFLATED, raw ? -15 : 15, 8, strategy) != Z_OK)
+		return false;
+	out.resize(deflateBound(&stream, (uLong)input.size()) + 1024);
+	stream.next_out = out.data();
+	stream.avail_out = (uInt)out.size();
+	size_t at = 0;
+	int result = Z_OK;
+	while (result == Z_OK) {
+		size_t chunk = std::min(input.size() - at, (size_t)(random() % 65536 + 1));
+		stream.next_in = const_cast<stbi_uc*>(input.data()) + at;
+		stream.avail_in = (uInt)chunk;
+		at += chunk;
+		int flush = at == input.size() ? Z_FINISH : (random() % 4 == 0 ? Z_FULL_FLUSH : Z_NO_FLUSH);
+		result = deflate(&stream, flush);
+		if (result == Z_OK && flush != Z_NO_FLUSH && random() % 2 == 0)
+			result = deflateParams(&stream, (int)(random() % 10), strategy);
+	}
+	out.resize(stream.total_out);
+	deflateEnd(&stream);
+	return result == Z_STREAM_END;
+}
+
+// stbi_zlib_decode_buffer, with the loop picked by the caller. Returns the bytes written
+// or -1, and false if anything past length was touched.
+static bool Inflate(const std::vector<stbi_uc>& stream, bool raw, bool careful, std::vector<stbi_uc>& out, int length, int* written) {
+	out.assign(length + GUARD_BYTES, 0xAA);
+	stbi__zbuf z;
+	z.zbuffer = const_cast<stbi_uc*>(stream.data());
+	z.zbuffer_end = z.zbuffer + stream.size();
+	z.zout_start = z.zout = (char*)out.data();
+	z.zout_end = z.zout_start + length;
+	z.z_expandable = 0;
+	z.careful_only = careful;
+	*written = stbi__parse_zlib(&z, !raw) ? (int)(z.zout - z.zout_start) : -1;
+	for (int i = 0; i < GUARD_BYTES; i++) {
+		if (out[length + i] != 0xAA)
+			return false;
+	}
+	return true;
+}
+
+// Both loops must write the same bytes, and the expected ones when given
+static bool SameInflate(const std::vector<stbi_uc>& stream, bool raw, int length, const std::vector<stbi_uc>* expected, const std::string& name) {
+	std::vector<stbi_uc> fast, careful;
+	int fastWritten, carefulWritten;
+	bool fastGuard = Inflate(stream, raw, false, fast, length, &fastWritten);
+	bool carefulGuard = Inflate(stream, raw, true, careful, length, &carefulWritten);
+	const char* problem = nullptr;
+	if (!fastGuard || !carefulGuard)
+		problem = fastGuard ? "careful loop wrote past the buffer" : "fast loop wrote past the buffer";
+	else if (fastWritten != carefulWritten)
+		problem = "loops wrote different lengths";
+	else if (fastWritten > 0 && memcmp(fast.data(), careful.data(), fastWritten) != 0)
+		problem = "loops wrote different bytes";
+	else if (expected && (fastWritten != (int)expected->size() || memcmp(fast.data(), expected->data(), expected->size()) != 0))
+		problem = "output differs from the input";
+	if (problem)
+		std::cout << "Inflate: " << name << ": " << problem << " (fast " << fastWritten << ", careful " << carefulWritten << " bytes)" << std::endl;
+	return problem == nullptr;
+}
+
+static void Corrupt(std::mt19937& random, std::vector<stbi_uc>& stream) {
+	if (stream.empty())
+		return;
+	switch (random() % 3) {
+	case 0:
+		stream.resize(random() % stream.size());
+		break;
+	case 1:
+		for (int i = 0, flips = (int)(random() % 8) + 1; i < flips; i++)
+			stream[random() % stream.size()] ^= (stbi_uc)(1 << (random() % 8));
+		break;
+	default:
+		for (int i = 0, bytes = (int)(random() % 8) + 1; i < bytes; i++)
+			stream[random() % stream.size()] = (stbi_uc)random();
+		break;
+	}
+}
+
+static bool CheckGeneratedStreams(std::mt19937& random, int* streams, int* corruptions) {
+	const int levels[] = { 0, 1, 6, 9 };
+	bool same = true;
+	std::vector<stbi_uc> input, stream;
+	for (int level : levels) {
+		for (int s = 0; s < 5; s++) {
+			for (int raw = 0; raw < 2; raw++) {
+				for (int i = 0; i < STREAMS_PER_SETTING; i++) {
+					Content content = (Content)(i % CONTENT_COUNT);
+					size_t size = i % 4 == 0 ? random() % 64 : random() % (256 * 1024);
+					Generate(random, content, size, input);
+					if (!Compress(random, input, level, STRATEGIES[s], raw != 0, stream)) {
+						std::cout << "Inflate: zlib failed to compress" << std::endl;
+						return false;
+					}
+					std::string name = std::string(raw ? "raw" : "zlib") + " level " + std::to_string(level) + " " +
+						STRATEGY_NAMES[s] + " stream " + std::to_string(i) + " (" + std::to_string(size) + " bytes)";
+					same = SameInflate(stream, raw != 0, (int)input.size(), &input, name) && same;
+					(*streams)++;
+
+					for (int c = 0; c < CORRUPTIONS_PER_STREAM; c++) {
+						std::vector<stbi_uc> corrupt = stream;
+						Corrupt(random, corrupt);
+						same = SameInflate(corrupt, raw != 0, (int)input.size(), nullptr, name + " corruption " + std::to_string(c)) && same;
+						(*corruptions)++;
+					}
+				}
+			}
+		}
+	}
+	return same;
+}
+
+static unsigned int BigEndian(const stbi_uc* p) {
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+// The concatenated IDAT chunks of a PNG, one zlib stream
+static bool ReadIdat(const char* path, std::vector<stbi_uc>& idat) {
+	std::ifstream stream(path, std::ios::binary);
+	std::vector<stbi_uc> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	if (file.size() < 33 || memcmp(file.data() + 12, "IHDR", 4) != 0)
+		return false;
+	idat.clear();
+	for (size_t at = 8; at + 12 <= file.size();) {
+		size_t length = BigEndian(&file[at]);
+		if (at + 12 + length > file.size())
+			break;
+		if (memcmp(&file[at + 4], "IDAT", 4) == 0)
+			idat.insert(idat.end(), file.begin() + at + 8, file.begin() + at + 8 + length);
+		at += 12 + length;
+	}
+	return !idat.empty();
+}
+
+static double MegabytesPerSecond(size_t bytes, int runs, double seconds) {
+	return bytes * (double)runs / (1024.0 * 1024.0) / seconds;
+}
+
+// Output MB/s of one loop, runs repeated until TIMING_SECONDS have passed
+static double TimeInflate(const std::vector<stbi_uc>& stream, bool careful, int length) {
+	std::vector<stbi_uc> out;
+	int written, runs = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double seconds = 0.0;
+	while (seconds < TIMING_SECONDS || runs < 3) {
+		Inflate(stream, false, careful, out, length, &written);
+		runs++;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	return MegabytesPerSecond(length, runs, seconds);
+}
+
+static bool CheckFile(const char* path) {
+	std::vector<stbi_uc> idat;
+	int length = 0;
+	char* inflated = ReadIdat(path, idat) ? stbi_zlib_decode_malloc((const char*)idat.data(), (int)idat.size(), &length) : nullptr;
+	if (!inflated) {
+		std::cout << "File: can't inflate " << path << std::endl;
+		return false;
+	}
+	std::vector<stbi_uc> expected(inflated, inflated + length);
+	STBI_FREE(inflated);
+
+	bool same = SameInflate(idat, false, length, &expected, path);
+	std::cout << "File: " << path << " (" << idat.size() / 1024 << " KB to " << length / 1024 << " KB) "
+		<< (same ? "same" : "MISMATCH") << ", MB/s fast " << (int)TimeInflate(idat, false, length)
+		<< ", careful " << (int)TimeInflate(idat, true, length) << std::endl;
+	return same;
+}
+
+static void TimeGenerated(std::mt19937& random) {
+	struct Timing {
+		const char* name;
+		Content content;
+	};
+	const Timing timings[] = { { "matchy", Content::Image }, { "mostly literal", Content::Text }, { "runs", Content::Runs } };
+	std::vector<stbi_uc> input, stream;
+	for (const Timing& timing : timings) {
+		Generate(random, timing.content, TIMING_BYTES, input);
+		uLongf size = compressBound((uLong)input.size());
+		stream.resize(size);
+		compress2(stream.data(), &size, input.data(), (uLong)input.size(), 6);
+		stream.resize(size);
+		std::cout << "Inflate: " << TIMING_BYTES / (1024 * 1024) << " MB " << timing.name << " at level 6 ("
+			<< stream.size() / 1024 << " KB), MB/s fast " << (int)TimeInflate(stream, false, (int)input.size())
+			<< ", careful " << (int)TimeInflate(stream, true, (int)input.size()) << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	std::mt19937 random(29);
+	int streams = 0, corruptions = 0;
+	bool same = CheckGeneratedStreams(random, &streams, &corruptions);
+	std::cout << "Inflate: " << streams << " streams round trip, " << corruptions << " corrupted copies, "
+		<< (same ? "both loops agree" : "MISMATCH") << std::endl;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			same = CheckFile(argv[i]) && same;
+	}
+	else {
+		for (const char* path : defaultImages)
+			same = CheckFile(path) && same;
+	}
+
+	TimeGenerated(random);
+	return same ? 0 : 1;
+}
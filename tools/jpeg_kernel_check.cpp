@@ -0,0 +1,262 @@
+// Checks stb_image's SIMD JPEG kernels against the scalar ones and times whole
+// JPEG decodes with each set of kernels. Not part of the app, build it on its own:
+//
+//   g++ -std=c++17 -O2 tools/jpeg_kernel_check.cpp -o jpeg_kernel_check
+//   ./jpeg_kernel_check [image.jpg ...]
+//
+// With no arguments it decodes container.jpg and the JPEGs in the benchmark corpus.
+// Exits with 1 if any kernel or decode differs from the scalar path by a single bit.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Each decode is repeated until both are reached, the best run is reported
+static const int DECODE_MIN_RUNS = 5;
+static const double DECODE_SECONDS_PER_LEVEL = 0.25;
+
+// Random blocks and rows checked per kernel
+static const int KERNEL_TRIALS = 20000;
+
+static const double PI = 3.14159265358979323846;
+
+static const char* defaultImages[] = {
+	"resources/textures/container.jpg",
+	"resources/benchmark/baseline_420.jpg",
+	"resources/benchmark/baseline_444.jpg",
+	"resources/benchmark/baseline_gray.jpg",
+	"resources/benchmark/progressive_420.jpg",
+	"resources/benchmark/restart_420.jpg",
+};
+
+struct KernelSet {
+	const char* name;
+	bool wideIdct;      // 32-bit intermediates, exact for any coefficients a file can hold
+	void (*idct)(stbi_uc* out, int out_stride, short data[64]);
+	void (*YCbCrToRGB)(stbi_uc* out, const stbi_uc* y, const stbi_uc* pcb, const stbi_uc* pcr, int count, int step);
+	stbi_uc* (*resampleHV2)(stbi_uc* out, stbi_uc* in_near, stbi_uc* in_far, int w, int hs);
+};
+
+static std::vector<KernelSet> AvailableKernels() {
+	std::vector<KernelSet> sets;
+	sets.push_back({ "scalar", true, stbi__idct_block, stbi__YCbCr_to_RGB_row, stbi__resample_row_hv_2 });
+#ifdef STBI_SSE2
+	if (stbi__sse2_available())
+		sets.push_back({ "sse2", false, stbi__idct_simd, stbi__YCbCr_to_RGB_simd, stbi__resample_row_hv_2_simd });
+#endif
+#ifdef STBI_AVX2
+	if (stbi__avx2_available())
+		sets.push_back({ "avx2", true, stbi__idct_avx2, stbi__YCbCr_to_RGB_avx2, stbi__resample_row_hv_2_avx2 });
+#endif
+	return sets;
+}
+
+// Coefficients of a real 8-bit block: the forward DCT of random samples, quantized
+// and dequantized, in the natural order the IDCT takes
+static void EncodedBlock(std::mt19937& random, short block[64]) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> quality(1, 64);
+	std::uniform_int_distribution<int> smooth(0, 1);
+	int samples[64];
+	int base = byte(random);
+	bool flat = smooth(random) != 0;
+	for (int i = 0; i < 64; i++)
+		samples[i] = flat ? std::min(255, std::max(0, base + byte(random) / 16 - 8)) : byte(random);
+
+	int step = quality(random);
+	for (int v = 0; v < 8; v++) {
+		for (int u = 0; u < 8; u++) {
+			double sum = 0.0;
+			for (int y = 0; y < 8; y++)
+				for (int x = 0; x < 8; x++)
+					sum += (samples[y * 8 + x] - 128) * cos((2 * x + 1) * u * PI / 16) * cos((2 * y + 1) * v * PI / 16);
+			double scale = (u ? 0.5 : 0.5 / sqrt(2.0)) * (v ? 0.5 : 0.5 / sqrt(2.0));
+			block[v * 8 + u] = (short)(lround(sum * scale / step) * step);
+		}
+	}
+}
+
+// Any coefficients at all, as a corrupt or hostile file can hold
+static void RandomBlock(std::mt19937& random, short block[64]) {
+	std::uniform_int_distribution<int> full(-32768, 32767);
+	for (int i = 0; i < 64; i++)
+		block[i] = (short)full(random);
+}
+
+// True when the kernel wrote the same bytes as scalar, inside the block and not outside it
+static bool SameIdct(const KernelSet& set, const KernelSet& scalar, const short block[64]) {
+	stbi_uc expected[16 * 8], out[16 * 8];
+	short input[64];
+	memset(expected, 0xAA, sizeof(expected));
+	memcpy(input, block, sizeof(input));
+	scalar.idct(expected, 16, input);
+	memset(out, 0xAA, sizeof(out));
+	memcpy(input, block, sizeof(input));
+	set.idct(out, 16, input);
+	return memcmp(out, expected, sizeof(out)) == 0;
+}
+
+// Every kernel must match scalar on blocks real images produce. The SSE2 IDCT works in
+// 16 bits and wraps on out of range coefficients, so only wide kernels are held to
+// scalar on arbitrary ones.
+static bool CheckIdct(const std::vector<KernelSet>& sets, std::mt19937& random) {
+	bool same = true;
+	for (int trial = 0; trial < KERNEL_TRIALS; trial++) {
+		short encoded[64], arbitrary[64];
+		EncodedBlock(random, encoded);
+		RandomBlock(random, arbitrary);
+		for (size_t k = 1; k < sets.size(); k++) {
+			if (!SameIdct(sets[k], sets[0], encoded)) {
+				std::cout << "IDCT: " << sets[k].name << " differs from scalar on encoded block " << trial << std::endl;
+				same = false;
+			}
+			if (sets[k].wideIdct && !SameIdct(sets[k], sets[0], arbitrary)) {
+				std::cout << "IDCT: " << sets[k].name << " differs from scalar on arbitrary block " << trial << std::endl;
+				same = false;
+			}
+		}
+		if (!same)
+			break;
+	}
+	return same;
+}
+
+static bool CheckYCbCr(const std::vector<KernelSet>& sets, std::mt19937& random) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> length(1, 200);
+	bool same = true;
+	for (int trial = 0; trial < KERNEL_TRIALS && same; trial++) {
+		int count = length(random);
+		int step = trial & 1 ? 4 : 3;
+		std::vector<stbi_uc> y(count), cb(count), cr(count);
+		for (int i = 0; i < count; i++) {
+			y[i] = (stbi_uc)byte(random);
+			cb[i] = (stbi_uc)byte(random);
+			cr[i] = (stbi_uc)byte(random);
+		}
+
+		// Alpha isn't written, so every run starts from the same bytes
+		std::vector<stbi_uc> expected(count * 4 + 16, 0xAA);
+		sets[0].YCbCrToRGB(expected.data(), y.data(), cb.data(), cr.data(), count, step);
+		for (size_t k = 1; k < sets.size(); k++) {
+			std::vector<stbi_uc> out(count * 4 + 16, 0xAA);
+			sets[k].YCbCrToRGB(out.data(), y.data(), cb.data(), cr.data(), count, step);
+			if (out != expected) {
+				std::cout << "YCbCr: " << sets[k].name << " differs from scalar for " << count << " pixels, step " << step << std::endl;
+				same = false;
+			}
+		}
+	}
+	return same;
+}
+
+static bool CheckResampleHV2(const std::vector<KernelSet>& sets, std::mt19937& random) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::uniform_int_distribution<int> length(1, 200);
+	bool same = true;
+	for (int trial = 0; trial < KERNEL_TRIALS && same; trial++) {
+		int width = length(random);
+		std::vector<stbi_uc> nearRow(width), farRow(width);
+		for (int i = 0; i < width; i++) {
+			nearRow[i] = (stbi_uc)byte(random);
+			farRow[i] = (stbi_uc)byte(random);
+		}
+
+		std::vector<stbi_uc> expected(width * 2 + 32, 0xAA);
+		sets[0].resampleHV2(expected.data(), nearRow.data(), farRow.data(), width, 2);
+		for (size_t k = 1; k < sets.size(); k++) {
+			std::vector<stbi_uc> out(width * 2 + 32, 0xAA);
+			sets[k].resampleHV2(out.data(), nearRow.data(), farRow.data(), width, 2);
+			if (out != expected) {
+				std::cout << "Resample hv_2: " << sets[k].name << " differs from scalar for width " << width << std::endl;
+				same = false;
+			}
+		}
+	}
+	return same;
+}
+
+// stbi__jpeg_load with the kernels picked by the caller instead of by CPUID
+static stbi_uc* DecodeWith(const KernelSet& set, const std::vector<stbi_uc>& file, int* width, int* height, int* channels) {
+	stbi__context context;
+	stbi__start_mem(&context, file.data(), (int)file.size());
+	stbi__jpeg* jpeg = (stbi__jpeg*)stbi__malloc(sizeof(stbi__jpeg));
+	jpeg->s = &context;
+	stbi__setup_jpeg(jpeg);
+	jpeg->idct_block_kernel = set.idct;
+	jpeg->YCbCr_to_RGB_kernel = set.YCbCrToRGB;
+	jpeg->resample_row_hv_2_kernel = set.resampleHV2;
+	stbi_uc* pixels = load_jpeg_image(jpeg, width, height, channels, 4);
+	STBI_FREE(jpeg);
+	return pixels;
+}
+
+static bool CheckDecode(const std::vector<KernelSet>& sets, const char* path) {
+	std::ifstream stream(path, std::ios::binary);
+	std::vector<stbi_uc> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	int width, height, channels;
+	stbi_uc* expected = file.empty() ? nullptr : DecodeWith(sets[0], file, &width, &height, &channels);
+	if (!expected) {
+		std::cout << "Decode: can't decode " << path << std::endl;
+		return false;
+	}
+	size_t bytes = (size_t)width * height * 4;
+
+	bool same = true;
+	std::cout << "Decode: " << path << " (" << width << "x" << height << ", " << file.size() / 1024 << " KB)";
+	for (const KernelSet& set : sets) {
+		double best = 0.0, total = 0.0;
+		for (int run = 0; run < DECODE_MIN_RUNS || total < DECODE_SECONDS_PER_LEVEL; run++) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int w, h, n;
+			stbi_uc* pixels = DecodeWith(set, file, &w, &h, &n);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (run == 0 && (!pixels || memcmp(pixels, expected, bytes) != 0)) {
+				std::cout << std::endl << "Decode: " << set.name << " output differs from scalar";
+				same = false;
+			}
+			stbi_image_free(pixels);
+			best = run == 0 ? seconds : std::min(best, seconds);
+			total += seconds;
+		}
+		std::cout << ", " << set.name << " " << file.size() / (1024.0 * 1024.0) / best << " MB/s";
+	}
+	std::cout << std::endl;
+	stbi_image_free(expected);
+	return same;
+}
+
+int main(int argc, char** argv) {
+	std::vector<KernelSet> sets = AvailableKernels();
+	std::cout << "Kernels:";
+	for (const KernelSet& set : sets)
+		std::cout << " " << set.name;
+	std::cout << std::endl;
+
+	std::mt19937 random(28);
+	bool same = true;
+	same = CheckIdct(sets, random) && same;
+	same = CheckYCbCr(sets, random) && same;
+	same = CheckResampleHV2(sets, random) && same;
+	std::cout << "Kernels: " << KERNEL_TRIALS << " random inputs each, " << (same ? "bit-exact" : "MISMATCH") << std::endl;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			same = CheckDecode(sets, argv[i]) && same;
+	}
+	else {
+		for (const char* path : defaultImages)
+			same = CheckDecode(sets, path) && same;
+	}
+	return same ? 0 : 1;
+}
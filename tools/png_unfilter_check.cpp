@@ -0,0 +1,291 @@
+// Checks stb_image's SSE2 and AVX2 PNG scanline unfiltering and row emission against
+// the plain C path, and times them. Not part of the app, build it on its own:
+//
+//   g++ -std=c++17 -O2 tools/png_unfilter_check.cpp -o png_unfilter_check
+//   ./png_unfilter_check [image.png ...]
+//
+// Generated rows cover every filter type for 1 to 8 byte pixels and every depth,
+// channel count and out_n the emitter takes. The scanlines of non-interlaced PNGs
+// (by default the benchmark corpus and awesomeface.png) are inflated and run through
+// every level as well. Exits with 1 if any level differs from plain C by a single bit.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// Random rows checked per filter and pixel size, and per emitter layout
+static const int ROW_TRIALS = 2000;
+
+// Rows the size of a 2048 pixel wide image are timed until this much time has passed
+static const int TIMING_WIDTH = 2048;
+static const double TIMING_SECONDS = 0.1;
+
+// Bytes past the end of every output, which no level may touch
+static const int GUARD_BYTES = 64;
+
+static const char* defaultImages[] = {
+	"resources/textures/awesomeface.png",
+	"resources/benchmark/palette.png",
+	"resources/benchmark/rgb16.png",
+	"resources/benchmark/rgb8.png",
+	"resources/benchmark/rgba8_interlaced.png",
+};
+
+static const char* FILTER_NAMES[] = { "none", "sub", "up", "avg", "paeth" };
+static const char* LEVEL_NAMES[] = { "c", "sse2", "avx2" };
+
+// Levels stbi__create_png_image_raw can pick on this CPU
+static int SimdLevels() {
+	int levels = 1;
+#ifdef STBI_SSE2
+	if (stbi__sse2_available())
+		levels = 2;
+#endif
+#ifdef STBI_AVX2
+	if (levels == 2 && stbi__avx2_available())
+		levels = 3;
+#endif
+	return levels;
+}
+
+static void Fill(std::mt19937& random, std::vector<stbi_uc>& bytes) {
+	std::uniform_int_distribution<int> byte(0, 255);
+	for (stbi_uc& b : bytes)
+		b = (stbi_uc)byte(random);
+}
+
+// Unfilters raw against prior at every level and compares each with plain C
+static bool SameUnfilter(int levels, int filter, const std::vector<stbi_uc>& prior, const std::vector<stbi_uc>& raw, int n, int bpp,
+	std::vector<stbi_uc>* result = nullptr) {
+	std::vector<stbi_uc> expected(n + GUARD_BYTES, 0xAA);
+	stbi__png_unfilter_row(filter, expected.data(), prior.data(), raw.data(), n, bpp, 0);
+	bool same = true;
+	for (int level = 1; level < levels; level++) {
+		std::vector<stbi_uc> cur(n + GUARD_BYTES, 0xAA);
+		stbi__png_unfilter_row(filter, cur.data(), prior.data(), raw.data(), n, bpp, level);
+		if (cur != expected) {
+			std::cout << "Unfilter: " << LEVEL_NAMES[level] << " " << FILTER_NAMES[filter] << " differs from c for "
+				<< n << " bytes of " << bpp << " byte pixels" << std::endl;
+			same = false;
+		}
+	}
+	if (result)
+		result->assign(expected.begin(), expected.begin() + n);
+	return same;
+}
+
+static bool SameEmit(int levels, const std::vector<stbi_uc>& row, int x, int imgN, int outN, int depth) {
+	size_t size = (size_t)x * outN * (depth / 8) + GUARD_BYTES;
+	std::vector<stbi_uc> expected(size, 0xAA);
+	stbi__png_emit_row(expected.data(), row.data(), x, imgN, outN, depth, 0);
+	bool same = true;
+	for (int level = 1; level < levels; level++) {
+		std::vector<stbi_uc> out(size, 0xAA);
+		stbi__png_emit_row(out.data(), row.data(), x, imgN, outN, depth, level);
+		if (out != expected) {
+			std::cout << "Emit: " << LEVEL_NAMES[level] << " differs from c for " << x << " pixels, " << imgN << " to "
+				<< outN << " channels, " << depth << " bit" << std::endl;
+			same = false;
+		}
+	}
+	return same;
+}
+
+static bool CheckGeneratedRows(int levels, std::mt19937& random) {
+	std::uniform_int_distribution<int> pixels(1, 300);
+	bool same = true;
+
+	// 3, 4, 6 and 8 byte pixels take the SIMD paths; 1 and 2 check they stay out of the way.
+	// 6 and 8 are 16-bit RGB and RGBA.
+	const int pixelSizes[] = { 1, 2, 3, 4, 6, 8 };
+	for (int bpp : pixelSizes) {
+		for (int filter = 0; filter < 5; filter++) {
+			for (int trial = 0; trial < ROW_TRIALS && same; trial++) {
+				int n = pixels(random) * bpp;
+				std::vector<stbi_uc> prior(n), raw(n);
+				Fill(random, prior);
+				Fill(random, raw);
+				same = SameUnfilter(levels, filter, prior, raw, n, bpp) && same;
+			}
+		}
+	}
+
+	// Every layout the decoder emits: as is, with opaque alpha added, and 16-bit swapped
+	for (int depth = 8; depth <= 16; depth += 8) {
+		for (int imgN = 1; imgN <= 4; imgN++) {
+			for (int outN = imgN; outN <= std::min(imgN + 1, 4); outN++) {
+				for (int trial = 0; trial < ROW_TRIALS && same; trial++) {
+					int x = pixels(random);
+					std::vector<stbi_uc> row((size_t)x * imgN * (depth / 8));
+					Fill(random, row);
+					same = SameEmit(levels, row, x, imgN, outN, depth) && same;
+				}
+			}
+		}
+	}
+	return same;
+}
+
+static unsigned int BigEndian(const stbi_uc* p) {
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+// Runs the filtered scanlines of a PNG through every level, the way
+// stbi__create_png_image_raw does for a non-interlaced image
+static bool CheckFile(int levels, const char* path) {
+	std::ifstream stream(path, std::ios::binary);
+	std::vector<stbi_uc> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	if (file.size() < 33 || memcmp(file.data() + 12, "IHDR", 4) != 0) {
+		std::cout << "File: can't read " << path << std::endl;
+		return false;
+	}
+	int width = (int)BigEndian(&file[16]), height = (int)BigEndian(&file[20]);
+	int depth = file[24], color = file[25], interlace = file[28];
+	if (interlace) {
+		std::cout << "File: " << path << " is interlaced, its passes are covered by the generated rows" << std::endl;
+		return true;
+	}
+
+	std::vector<stbi_uc> idat;
+	for (size_t at = 8; at + 12 <= file.size();) {
+		size_t length = BigEndian(&file[at]);
+		if (at + 12 + length > file.size())
+			break;
+		if (memcmp(&file[at + 4], "IDAT", 4) == 0)
+			idat.insert(idat.end(), file.begin() + at + 8, file.begin() + at + 8 + length);
+		at += 12 + length;
+	}
+	int inflatedLength = 0;
+	char* inflated = stbi_zlib_decode_malloc((const char*)idat.data(), (int)idat.size(), &inflatedLength);
+
+	const int channels[] = { 1, 0, 3, 1, 2, 0, 4 };
+	int imgN = color <= 6 ? channels[color] : 0;
+	int rowBytes = (imgN * width * depth + 7) / 8;
+	if (!inflated || imgN == 0 || inflatedLength < (rowBytes + 1) * height) {
+		std::cout << "File: can't inflate " << path << std::endl;
+		STBI_FREE(inflated);
+		return false;
+	}
+
+	int bpp = std::max(1, imgN * depth / 8);
+	bool same = true;
+	std::vector<stbi_uc> prior(rowBytes, 0), raw(rowBytes), cur;
+	for (int y = 0; y < height && same; y++) {
+		const stbi_uc* line = (const stbi_uc*)inflated + (size_t)y * (rowBytes + 1);
+		int filter = line[0];
+		if (filter > 4)
+			break;
+		if (y == 0)
+			filter = first_row_filter[filter];
+		memcpy(raw.data(), line + 1, rowBytes);
+		same = SameUnfilter(levels, filter, prior, raw, rowBytes, bpp, &cur) && same;
+
+		// Rows with whole bytes per sample go through the emitter, with and without alpha
+		if (depth >= 8) {
+			same = SameEmit(levels, cur, width, imgN, imgN, depth) && same;
+			if (imgN < 4)
+				same = SameEmit(levels, cur, width, imgN, imgN + 1, depth) && same;
+		}
+		prior = cur;
+	}
+	STBI_FREE(inflated);
+
+	std::cout << "File: " << path << " (" << width << "x" << height << ", " << depth << " bit, " << imgN << " channels) "
+		<< (same ? "bit-exact" : "MISMATCH") << std::endl;
+	return same;
+}
+
+static double MegabytesPerSecond(size_t bytes, int runs, double seconds) {
+	return bytes * (double)runs / (1024.0 * 1024.0) / seconds;
+}
+
+static void TimeUnfilter(int levels, std::mt19937& random) {
+	const int pixelSizes[] = { 3, 4, 6, 8 };
+	for (int bpp : pixelSizes) {
+		int n = TIMING_WIDTH * bpp;
+		std::vector<stbi_uc> prior(n), raw(n), cur(n + GUARD_BYTES);
+		Fill(random, prior);
+		Fill(random, raw);
+		std::cout << "Unfilter: " << bpp << " byte pixels, MB/s";
+		for (int filter = 1; filter < 5; filter++) {
+			std::cout << (filter == 1 ? " " : ", ") << FILTER_NAMES[filter];
+			for (int level = 0; level < levels; level++) {
+				int runs = 0;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				double seconds = 0.0;
+				while (seconds < TIMING_SECONDS) {
+					for (int i = 0; i < 64; i++)
+						stbi__png_unfilter_row(filter, cur.data(), prior.data(), raw.data(), n, bpp, level);
+					runs += 64;
+					seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				}
+				std::cout << (level ? "/" : " ") << (int)MegabytesPerSecond(n, runs, seconds);
+			}
+		}
+		std::cout << " (" << LEVEL_NAMES[0];
+		for (int level = 1; level < levels; level++)
+			std::cout << "/" << LEVEL_NAMES[level];
+		std::cout << ")" << std::endl;
+	}
+}
+
+static void TimeEmit(int levels, std::mt19937& random) {
+	struct Layout {
+		int imgN, outN, depth;
+	};
+	const Layout layouts[] = { { 3, 4, 8 }, { 2, 2, 16 }, { 3, 3, 16 }, { 3, 4, 16 }, { 4, 4, 16 } };
+	for (const Layout& layout : layouts) {
+		std::vector<stbi_uc> row((size_t)TIMING_WIDTH * layout.imgN * (layout.depth / 8));
+		std::vector<stbi_uc> out((size_t)TIMING_WIDTH * layout.outN * (layout.depth / 8) + GUARD_BYTES);
+		Fill(random, row);
+		std::cout << "Emit: " << layout.imgN << " to " << layout.outN << " channels, " << layout.depth << " bit, MB/s";
+		for (int level = 0; level < levels; level++) {
+			int runs = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			double seconds = 0.0;
+			while (seconds < TIMING_SECONDS) {
+				for (int i = 0; i < 64; i++)
+					stbi__png_emit_row(out.data(), row.data(), TIMING_WIDTH, layout.imgN, layout.outN, layout.depth, level);
+				runs += 64;
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			std::cout << " " << LEVEL_NAMES[level] << " " << (int)MegabytesPerSecond(row.size(), runs, seconds);
+		}
+		std::cout << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	int levels = SimdLevels();
+	std::cout << "Levels:";
+	for (int level = 0; level < levels; level++)
+		std::cout << " " << LEVEL_NAMES[level];
+	std::cout << std::endl;
+
+	std::mt19937 random(30);
+	bool same = CheckGeneratedRows(levels, random);
+	std::cout << "Rows: " << ROW_TRIALS << " random rows per filter and pixel size and per emitter layout, "
+		<< (same ? "bit-exact" : "MISMATCH") << std::endl;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			same = CheckFile(levels, argv[i]) && same;
+	}
+	else {
+		for (const char* path : defaultImages)
+			same = CheckFile(levels, path) && same;
+	}
+
+	TimeUnfilter(levels, random);
+	TimeEmit(levels, random);
+	return same ? 0 : 1;
+}